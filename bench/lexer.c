@@ -0,0 +1,81 @@
+// lexes a large generated script a number of times and reports the
+// throughput. run with 'make bench'.
+#include "../src/arena.h"
+#include "../src/lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SCRIPT_SIZE (8 * 1024 * 1024)
+#define ROUNDS 20
+
+static const char *lines[] = {
+  "let name \"value with some words in it\"\n",
+  "println \"$name and ${other} and $(command -v ls)\"\n",
+  "if test \"$i\" \"<\" 100000\n",
+  "  /usr/local/share/some/long/path/to/a/program --option=value --another-option file.txt\n",
+  "  cat input.txt | grep -v pattern | sort -u > output.txt 2>&1\n",
+  "end\n",
+  "for x in \"a b c d e f g h\" by \" \"\n",
+  "  mut total \"$((total + x))\" && println ok || println failed\n",
+  "# a comment that the lexer skips over until the end of the line\n",
+  "fun greet; println 'hello there'; end\n",
+};
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *generate_script(size_t *len)
+{
+  char *script = malloc(SCRIPT_SIZE + 256);
+  size_t n = 0;
+
+  for (int i = 0; n < SCRIPT_SIZE; i++) {
+    const char *line = lines[i % (sizeof(lines) / sizeof(lines[0]))];
+    size_t line_len = strlen(line);
+    memcpy(script + n, line, line_len);
+    n += line_len;
+  }
+
+  script[n] = '\0';
+  *len = n;
+
+  return script;
+}
+
+int main()
+{
+  size_t len;
+  char *script = generate_script(&len);
+  Arena arena = {0};
+  int tokens = 0;
+  double start = seconds();
+
+  for (int i = 0; i < ROUNDS; i++) {
+    Arena_Mark mark = arena_mark(&arena);
+    tokens = lexer_get_tokens(Z_SV(script, len), &arena).len;
+    arena_release(&arena, mark);
+  }
+
+  double elapsed = seconds() - start;
+  double megabytes = (double)len * ROUNDS / (1024 * 1024);
+
+  printf("lexer: %d tokens in %.1f MB, %.1f MB/s\n", tokens, (double)len / (1024 * 1024), megabytes / elapsed);
+
+  arena_free(&arena);
+  free(script);
+
+  return 0;
+}
+
+#define LIBZATAR_IMPLEMENTATION
+#include "../src/libzatar.h"
+
+#define CSTR_IMPLEMENTATION
+#include "../src/cstr.h"
@@ -0,0 +1,86 @@
+// launches a command many times while the shell holds heaps of a few
+// sizes, once the way commands are spawned and once with fork and
+// execvp, and reports the time per launch. run with 'make bench'.
+#include "../src/spawn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB (1024 * 1024)
+#define LAUNCHES 1000
+
+static const size_t heap_sizes[] = { 0, 16 * MB, 256 * MB, 1024 * MB };
+
+static char *command[] = { "/bin/true", NULL };
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void launch_spawn()
+{
+  wait_process(spawn_process(command, STDIN_FILENO, STDOUT_FILENO, NULL));
+}
+
+static void launch_fork()
+{
+  int pid = fork();
+
+  if (pid == 0) {
+    execvp(command[0], command);
+    _exit(127);
+  }
+
+  wait_process(pid);
+}
+
+static void report(const char *name, size_t heap_size, void (*launch)())
+{
+  double start = seconds();
+
+  for (int i = 0; i < LAUNCHES; i++) {
+    launch();
+  }
+
+  double elapsed = seconds() - start;
+  printf("spawn: %-11s %4zu MB heap, %d launches, %.1f us each\n",
+      name, heap_size / MB, LAUNCHES, elapsed * 1e6 / LAUNCHES);
+}
+
+int main()
+{
+  for (size_t i = 0; i < sizeof(heap_sizes) / sizeof(heap_sizes[0]); i++) {
+    size_t size = heap_sizes[i];
+    char *heap = malloc(size);
+
+    if (size > 0 && !heap) {
+      printf("spawn: no room for a %zu MB heap\n", size / MB);
+      continue;
+    }
+
+    // touched, so fork has page tables to copy
+    if (heap) {
+      memset(heap, 1, size);
+    }
+
+    report("posix_spawn", size, launch_spawn);
+    report("fork", size, launch_fork);
+
+    free(heap);
+  }
+
+  return 0;
+}
+
+#define LIBZATAR_IMPLEMENTATION
+#include "../src/libzatar.h"
+
+#define CSTR_IMPLEMENTATION
+#include "../src/cstr.h"
@@ -0,0 +1,111 @@
+// starts the shell many times on a large generated script, parsing it
+// every time, loading it from the AST cache, and with an empty script
+// for comparison. run with 'make bench', after the shell is built.
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ALIASES 300
+#define BRANCHES 3000
+#define RUNS 100
+
+extern char **environ;
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// aliases and one large function that is defined but never called,
+// like an init file
+static void generate_script(const char *path)
+{
+  FILE *script = fopen(path, "w");
+
+  for (int i = 0; i < ALIASES; i++) {
+    fprintf(script, "alias a%d 'println alias number %d'\n", i, i);
+  }
+
+  fprintf(script, "fun dispatch\n");
+
+  for (int i = 0; i < BRANCHES; i++) {
+    fprintf(script, "  if test \"$1\" == \"%d\"\n    println \"branch %d\" | cat > /dev/null\n  end\n", i, i);
+  }
+
+  fprintf(script, "end\n");
+  fclose(script);
+}
+
+static void run(char **argv)
+{
+  int pid;
+
+  if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ) != 0) {
+    perror(argv[0]);
+    exit(1);
+  }
+
+  waitpid(pid, NULL, 0);
+}
+
+static void report(const char *name, char **argv)
+{
+  double start = seconds();
+
+  for (int i = 0; i < RUNS; i++) {
+    run(argv);
+  }
+
+  double elapsed = seconds() - start;
+  printf("startup: %-12s %d runs, %.2f ms each\n", name, RUNS, elapsed * 1e3 / RUNS);
+}
+
+int main()
+{
+  char home[] = "/tmp/flint-startup-XXXXXX";
+
+  if (!mkdtemp(home)) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  char script[256];
+  char empty[256];
+  char command[512];
+  snprintf(script, sizeof(script), "%s/script.flint", home);
+  snprintf(empty, sizeof(empty), "%s/empty.flint", home);
+  snprintf(command, sizeof(command), "mkdir -p %s/.config/flint && touch %s/.config/flint/init.flint %s", home, home, empty);
+  system(command);
+  generate_script(script);
+
+  // the shell's own init file and cache stay out of it
+  setenv("HOME", home, 1);
+  snprintf(command, sizeof(command), "%s/.cache", home);
+  setenv("XDG_CACHE_HOME", command, 1);
+
+  char *no_cache[] = { "./exe", "--no-cache", script, NULL };
+  char *cached[] = { "./exe", script, NULL };
+  char *nothing[] = { "./exe", empty, NULL };
+
+  report("--no-cache", no_cache);
+  run(cached);
+  report("cached", cached);
+  report("empty", nothing);
+
+  snprintf(command, sizeof(command), "rm -rf %s", home);
+  system(command);
+
+  return 0;
+}
+
+#define LIBZATAR_IMPLEMENTATION
+#include "../src/libzatar.h"
+
+#define CSTR_IMPLEMENTATION
+#include "../src/cstr.h"
@@ -0,0 +1,158 @@
+// compares Z_Map with Table on put, get and remove, once for a key set
+// the size of a scope's variables and once for one the size of a long
+// alias list, and reports the time per operation. run with 'make bench'.
+#include "../src/libzatar.h"
+#include "../src/table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OPERATIONS 4000000
+
+typedef struct {
+  const char *name;
+  int count;
+} Key_Set;
+
+static const Key_Set key_sets[] = {
+  { "scope", 8 },
+  { "alias", 512 },
+};
+
+static double seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char **generate_keys(int count)
+{
+  char **keys = malloc(count * sizeof(char *));
+
+  for (int i = 0; i < count; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), i % 2 ? "name_%d" : "x%d", i);
+    keys[i] = strdup(key);
+  }
+
+  return keys;
+}
+
+// times are in seconds for all rounds, by operation
+typedef struct {
+  double put;
+  double get;
+  double remove;
+} Times;
+
+static Times bench_map(char **keys, int count, int rounds)
+{
+  Times times = {0};
+  int found = 0;
+
+  for (int r = 0; r < rounds; r++) {
+    Z_Map *map = z_map_new((Z_Compare_Fn)strcmp);
+
+    double start = seconds();
+    for (int i = 0; i < count; i++) {
+      z_map_put(map, strdup(keys[i]), keys[i], free, NULL);
+    }
+    times.put += seconds() - start;
+
+    start = seconds();
+    for (int i = 0; i < count; i++) {
+      found += z_map_get(map, keys[i]) != NULL;
+    }
+    times.get += seconds() - start;
+
+    start = seconds();
+    for (int i = 0; i < count; i++) {
+      z_map_remove(map, keys[i], free, NULL);
+    }
+    times.remove += seconds() - start;
+
+    z_map_free(map, free, NULL);
+  }
+
+  if (found != count * rounds) {
+    fprintf(stderr, "table: Z_Map lost keys\n");
+    exit(1);
+  }
+
+  return times;
+}
+
+static Times bench_table(char **keys, int count, int rounds)
+{
+  Times times = {0};
+  int found = 0;
+
+  for (int r = 0; r < rounds; r++) {
+    Table table = {0};
+
+    double start = seconds();
+    for (int i = 0; i < count; i++) {
+      table_put(&table, Z_CSTR(keys[i]), keys[i], NULL);
+    }
+    times.put += seconds() - start;
+
+    start = seconds();
+    for (int i = 0; i < count; i++) {
+      found += table_get(&table, Z_CSTR(keys[i])) != NULL;
+    }
+    times.get += seconds() - start;
+
+    start = seconds();
+    for (int i = 0; i < count; i++) {
+      table_remove(&table, Z_CSTR(keys[i]), NULL);
+    }
+    times.remove += seconds() - start;
+
+    table_free(&table, NULL);
+  }
+
+  if (found != count * rounds) {
+    fprintf(stderr, "table: Table lost keys\n");
+    exit(1);
+  }
+
+  return times;
+}
+
+static void report(const char *set, const char *operation, double map, double table)
+{
+  printf("table: %-6s %-7s Z_Map %6.1f ns, Table %6.1f ns\n",
+      set, operation, map * 1e9 / OPERATIONS, table * 1e9 / OPERATIONS);
+}
+
+int main()
+{
+  for (size_t i = 0; i < sizeof(key_sets) / sizeof(key_sets[0]); i++) {
+    const Key_Set *set = &key_sets[i];
+    char **keys = generate_keys(set->count);
+    int rounds = OPERATIONS / set->count;
+
+    Times map = bench_map(keys, set->count, rounds);
+    Times table = bench_table(keys, set->count, rounds);
+
+    report(set->name, "put", map.put, table.put);
+    report(set->name, "get", map.get, table.get);
+    report(set->name, "remove", map.remove, table.remove);
+
+    for (int j = 0; j < set->count; j++) {
+      free(keys[j]);
+    }
+    free(keys);
+  }
+
+  return 0;
+}
+
+#define LIBZATAR_IMPLEMENTATION
+#include "../src/libzatar.h"
+
+#define CSTR_IMPLEMENTATION
+#include "../src/cstr.h"
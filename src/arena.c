@@ -0,0 +1,172 @@
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct Arena_Block {
+  Arena_Block *next;
+  size_t size;
+  size_t used;
+  _Alignas(ARENA_ALIGNMENT) char data[];
+};
+
+static size_t align_up(size_t n)
+{
+  return (n + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static Arena_Block *new_block(size_t size)
+{
+  size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+  Arena_Block *block = malloc(sizeof(Arena_Block) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+// moves on to the next block that can hold size bytes, reusing blocks
+// left over from a release before allocating a new one. leftovers too
+// small for it are freed, otherwise a value growing a little with every
+// command would leave one more of them behind each time.
+static Arena_Block *next_block(Arena *arena, size_t size)
+{
+  Arena_Block *current = arena->current;
+
+  while (current && current->next) {
+    Arena_Block *next = current->next;
+
+    if (next->size >= size) {
+      next->used = 0;
+      return next;
+    }
+
+    current->next = next->next;
+    free(next);
+  }
+
+  Arena_Block *block = new_block(size);
+
+  if (!arena->first) {
+    arena->first = block;
+  } else {
+    arena->current->next = block;
+  }
+
+  return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+  Arena_Block *block = arena->current;
+
+  if (!block || align_up(block->used) + size > block->size) {
+    block = next_block(arena, size);
+    arena->current = block;
+  }
+
+  block->used = align_up(block->used);
+  void *ptr = block->data + block->used;
+  block->used += size;
+
+  return ptr;
+}
+
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+  Arena_Block *block = arena->current;
+
+  if (ptr && block && (char *)ptr + old_size == block->data + block->used
+      && (char *)ptr + new_size <= block->data + block->size) {
+    block->used += new_size - old_size;
+    return ptr;
+  }
+
+  void *new_ptr = arena_alloc(arena, new_size);
+
+  if (ptr) {
+    memcpy(new_ptr, ptr, old_size);
+  }
+
+  return new_ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t len)
+{
+  char *copy = arena_alloc(arena, len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+Arena_Mark arena_mark(const Arena *arena)
+{
+  return (Arena_Mark){
+    .block = arena->current,
+    .used = arena->current ? arena->current->used : 0,
+  };
+}
+
+void arena_release(Arena *arena, Arena_Mark mark)
+{
+  if (!mark.block) {
+    arena->current = arena->first;
+
+    if (arena->first) {
+      arena->first->used = 0;
+    }
+
+    return;
+  }
+
+  arena->current = mark.block;
+  arena->current->used = mark.used;
+}
+
+// frees the blocks kept around after the current one, everything in
+// them was released
+void arena_trim(Arena *arena)
+{
+  if (!arena->current) {
+    return;
+  }
+
+  Arena_Block *block = arena->current->next;
+  arena->current->next = NULL;
+
+  while (block) {
+    Arena_Block *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+void arena_free(Arena *arena)
+{
+  Arena_Block *block = arena->first;
+
+  while (block) {
+    Arena_Block *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  *arena = (Arena){0};
+}
+
+size_t arena_size(const Arena *arena)
+{
+  size_t size = 0;
+
+  for (Arena_Block *block = arena->first; block; block = block->next) {
+    size += block->size;
+  }
+
+  return size;
+}
@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "libzatar.h"
+#include <stddef.h>
+
+typedef struct Arena_Block Arena_Block;
+
+// a bump allocator. memory is only given back all at once, either by
+// freeing the arena or by releasing everything allocated after a mark.
+// released blocks are kept and reused by later allocations.
+typedef struct {
+  Arena_Block *first;
+  Arena_Block *current;
+} Arena;
+
+typedef struct {
+  Arena_Block *block;
+  size_t used;
+} Arena_Mark;
+
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+Arena_Mark arena_mark(const Arena *arena);
+void arena_release(Arena *arena, Arena_Mark mark);
+void arena_trim(Arena *arena);
+void arena_free(Arena *arena);
+size_t arena_size(const Arena *arena);
+
+#define arena_new(arena, Type) ((Type *)arena_alloc((arena), sizeof(Type)))
+
+// z_da_append for arrays whose memory lives in an arena. an array that
+// is still the last allocation grows in place.
+#define arena_da_append(arena, da, item)                                       \
+  do {                                                                         \
+    if ((da)->len >= (da)->cap) {                                              \
+      int new_cap = (da)->cap ? (da)->cap * 2 : 8;                             \
+      (da)->ptr = arena_grow((arena), (da)->ptr,                               \
+                             sizeof(*(da)->ptr) * (da)->cap,                   \
+                             sizeof(*(da)->ptr) * new_cap);                    \
+      (da)->cap = new_cap;                                                     \
+    }                                                                          \
+    (da)->ptr[(da)->len++] = (item);                                           \
+  } while (0)
+
+#endif
@@ -0,0 +1,427 @@
+#include "arithmetic.h"
+#include "state.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAME_LENGTH 256
+
+static Number integer(long long value)
+{
+  return (Number){ .is_float = false, .integer = value };
+}
+
+static Number real(double value)
+{
+  return (Number){ .is_float = true, .real = value };
+}
+
+static double as_real(Number n)
+{
+  return n.is_float ? n.real : (double)n.integer;
+}
+
+static bool is_true(Number n)
+{
+  return n.is_float ? n.real != 0 : n.integer != 0;
+}
+
+// plain decimal integers are read with strtoll, anything else has to
+// be a float strtod reads completely. 'inf' and 'nan' are not numbers.
+bool number_parse(const char *s, Number *number)
+{
+  const char *digits = s + (*s == '-' || *s == '+');
+
+  if (!isdigit((unsigned char)*digits) && *digits != '.') {
+    return false;
+  }
+
+  char *end;
+  errno = 0;
+  long long value = strtoll(s, &end, 10);
+
+  if (*end == '\0' && errno == 0) {
+    *number = integer(value);
+    return true;
+  }
+
+  double d = strtod(s, &end);
+
+  if (*end != '\0') {
+    return false;
+  }
+
+  *number = real(d);
+
+  return true;
+}
+
+void number_format(Number number, char *buffer)
+{
+  if (number.is_float) {
+    snprintf(buffer, NUMBER_BUFFER_SIZE, "%.15g", number.real);
+  } else {
+    snprintf(buffer, NUMBER_BUFFER_SIZE, "%lld", number.integer);
+  }
+}
+
+int number_compare(Number a, Number b)
+{
+  if (!a.is_float && !b.is_float) {
+    return (a.integer > b.integer) - (a.integer < b.integer);
+  }
+
+  double x = as_real(a);
+  double y = as_real(b);
+
+  return (x > y) - (x < y);
+}
+
+// integers wrap around instead of overflowing
+Number number_add(Number a, Number b)
+{
+  if (!a.is_float && !b.is_float) {
+    return integer((unsigned long long)a.integer + (unsigned long long)b.integer);
+  }
+
+  return real(as_real(a) + as_real(b));
+}
+
+static Number subtract(Number a, Number b)
+{
+  if (!a.is_float && !b.is_float) {
+    return integer((unsigned long long)a.integer - (unsigned long long)b.integer);
+  }
+
+  return real(as_real(a) - as_real(b));
+}
+
+static Number multiply(Number a, Number b)
+{
+  if (!a.is_float && !b.is_float) {
+    return integer((unsigned long long)a.integer * (unsigned long long)b.integer);
+  }
+
+  return real(as_real(a) * as_real(b));
+}
+
+static Number power(Number base, Number exponent)
+{
+  if (base.is_float || exponent.is_float || exponent.integer < 0) {
+    return real(pow(as_real(base), as_real(exponent)));
+  }
+
+  unsigned long long result = 1;
+  unsigned long long b = base.integer;
+
+  for (long long e = exponent.integer; e > 0; e >>= 1) {
+    if (e & 1) {
+      result *= b;
+    }
+
+    b *= b;
+  }
+
+  return integer(result);
+}
+
+// a recursive descent parser that evaluates as it goes. the first
+// error stops the evaluation. the side of && or || that doesn't decide
+// the result is parsed with skip set, which ignores what can only go
+// wrong when evaluating, like a division by zero.
+typedef struct {
+  const char *p;
+  const char *error;
+  bool skip;
+} Arithmetic_Parser;
+
+static Number parse_or(Arithmetic_Parser *parser);
+static Number parse_unary(Arithmetic_Parser *parser);
+
+static void fail(Arithmetic_Parser *parser, const char *error)
+{
+  if (!parser->error) {
+    parser->error = error;
+  }
+}
+
+static void skip_spaces(Arithmetic_Parser *parser)
+{
+  while (isspace((unsigned char)*parser->p)) {
+    parser->p++;
+  }
+}
+
+static bool match(Arithmetic_Parser *parser, const char *operator)
+{
+  skip_spaces(parser);
+  size_t len = strlen(operator);
+
+  if (parser->error || strncmp(parser->p, operator, len) != 0) {
+    return false;
+  }
+
+  parser->p += len;
+
+  return true;
+}
+
+static bool is_name_char(char c)
+{
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+static Number variable(Arithmetic_Parser *parser)
+{
+  bool braced = *parser->p == '$' && parser->p[1] == '{';
+  parser->p += *parser->p == '$' ? 1 + braced : 0;
+
+  const char *start = parser->p;
+
+  while (is_name_char(*parser->p)) {
+    parser->p++;
+  }
+
+  size_t len = parser->p - start;
+
+  if (len == 0 || len >= MAX_NAME_LENGTH || (braced && *parser->p++ != '}')) {
+    fail(parser, "invalid variable name");
+    return integer(0);
+  }
+
+  char name[MAX_NAME_LENGTH];
+  memcpy(name, start, len);
+  name[len] = '\0';
+
+  Number value;
+
+  if (!select_variable_number(name, &value)) {
+    if (!parser->skip) {
+      fail(parser, "variable doesn't hold a number");
+    }
+
+    return integer(0);
+  }
+
+  return value;
+}
+
+static Number literal(Arithmetic_Parser *parser)
+{
+  char *end;
+  errno = 0;
+  long long value = strtoll(parser->p, &end, 10);
+
+  if (*end != '.' && *end != 'e' && *end != 'E' && errno == 0) {
+    parser->p = end;
+    return integer(value);
+  }
+
+  double d = strtod(parser->p, &end);
+  parser->p = end;
+
+  return real(d);
+}
+
+static Number parse_primary(Arithmetic_Parser *parser)
+{
+  if (match(parser, "(")) {
+    Number value = parse_or(parser);
+
+    if (!match(parser, ")")) {
+      fail(parser, "expected ')'");
+    }
+
+    return value;
+  }
+
+  skip_spaces(parser);
+  char c = *parser->p;
+
+  if (isdigit((unsigned char)c) || c == '.') {
+    return literal(parser);
+  }
+
+  if (c == '$' || c == '_' || isalpha((unsigned char)c)) {
+    return variable(parser);
+  }
+
+  fail(parser, c ? "unexpected character" : "unexpected end of expression");
+
+  return integer(0);
+}
+
+// '**' binds tighter than a sign on its left and is right associative
+static Number parse_power(Arithmetic_Parser *parser)
+{
+  Number base = parse_primary(parser);
+
+  if (match(parser, "**")) {
+    return power(base, parse_unary(parser));
+  }
+
+  return base;
+}
+
+static Number parse_unary(Arithmetic_Parser *parser)
+{
+  if (match(parser, "-")) {
+    Number value = parse_unary(parser);
+    return value.is_float ? real(-value.real) : integer(-(unsigned long long)value.integer);
+  }
+
+  if (match(parser, "+")) {
+    return parse_unary(parser);
+  }
+
+  if (match(parser, "!")) {
+    return integer(!is_true(parse_unary(parser)));
+  }
+
+  return parse_power(parser);
+}
+
+static Number divide(Arithmetic_Parser *parser, Number a, Number b, bool remainder)
+{
+  if (a.is_float || b.is_float) {
+    return real(remainder ? fmod(as_real(a), as_real(b)) : as_real(a) / as_real(b));
+  }
+
+  if (b.integer == 0) {
+    if (!parser->skip) {
+      fail(parser, "division by zero");
+    }
+
+    return integer(0);
+  }
+
+  // LLONG_MIN / -1 doesn't fit
+  if (b.integer == -1) {
+    return remainder ? integer(0) : integer(-(unsigned long long)a.integer);
+  }
+
+  return integer(remainder ? a.integer % b.integer : a.integer / b.integer);
+}
+
+static Number parse_multiplicative(Arithmetic_Parser *parser)
+{
+  Number value = parse_unary(parser);
+
+  for (;;) {
+    skip_spaces(parser);
+
+    if (parser->p[0] == '*' && parser->p[1] != '*' && match(parser, "*")) {
+      value = multiply(value, parse_unary(parser));
+    } else if (match(parser, "/")) {
+      value = divide(parser, value, parse_unary(parser), false);
+    } else if (match(parser, "%")) {
+      value = divide(parser, value, parse_unary(parser), true);
+    } else {
+      return value;
+    }
+  }
+}
+
+static Number parse_additive(Arithmetic_Parser *parser)
+{
+  Number value = parse_multiplicative(parser);
+
+  for (;;) {
+    if (match(parser, "+")) {
+      value = number_add(value, parse_multiplicative(parser));
+    } else if (match(parser, "-")) {
+      value = subtract(value, parse_multiplicative(parser));
+    } else {
+      return value;
+    }
+  }
+}
+
+static Number parse_relational(Arithmetic_Parser *parser)
+{
+  Number value = parse_additive(parser);
+
+  for (;;) {
+    if (match(parser, "<=")) {
+      value = integer(number_compare(value, parse_additive(parser)) <= 0);
+    } else if (match(parser, ">=")) {
+      value = integer(number_compare(value, parse_additive(parser)) >= 0);
+    } else if (match(parser, "<")) {
+      value = integer(number_compare(value, parse_additive(parser)) < 0);
+    } else if (match(parser, ">")) {
+      value = integer(number_compare(value, parse_additive(parser)) > 0);
+    } else {
+      return value;
+    }
+  }
+}
+
+static Number parse_equality(Arithmetic_Parser *parser)
+{
+  Number value = parse_relational(parser);
+
+  for (;;) {
+    if (match(parser, "==")) {
+      value = integer(number_compare(value, parse_relational(parser)) == 0);
+    } else if (match(parser, "!=")) {
+      value = integer(number_compare(value, parse_relational(parser)) != 0);
+    } else {
+      return value;
+    }
+  }
+}
+
+static Number parse_and(Arithmetic_Parser *parser)
+{
+  Number value = parse_equality(parser);
+
+  while (match(parser, "&&")) {
+    bool skip = parser->skip;
+    parser->skip = skip || !is_true(value);
+    bool right = is_true(parse_equality(parser));
+    parser->skip = skip;
+    value = integer(is_true(value) && right);
+  }
+
+  return value;
+}
+
+static Number parse_or(Arithmetic_Parser *parser)
+{
+  Number value = parse_and(parser);
+
+  while (match(parser, "||")) {
+    bool skip = parser->skip;
+    parser->skip = skip || is_true(value);
+    bool right = is_true(parse_and(parser));
+    parser->skip = skip;
+    value = integer(is_true(value) || right);
+  }
+
+  return value;
+}
+
+// integers, floats, variables by name, '$name' or '${name}', with the
+// C operators + - * / % ** < <= > >= == != && || ! and parentheses.
+// an unset or empty variable counts as 0.
+bool arithmetic_evaluate(const char *expression, Number *result)
+{
+  Arithmetic_Parser parser = { .p = expression, .error = NULL, .skip = false };
+  *result = parse_or(&parser);
+  skip_spaces(&parser);
+
+  if (!parser.error && *parser.p) {
+    fail(&parser, "unexpected character");
+  }
+
+  if (parser.error) {
+    fprintf(stderr, "'%s': %s\n", expression, parser.error);
+    return false;
+  }
+
+  return true;
+}
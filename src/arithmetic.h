@@ -0,0 +1,24 @@
+#ifndef ARITHMETIC_H
+#define ARITHMETIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// integers stay integers until an operation needs a fraction
+typedef struct {
+  bool is_float;
+  union {
+    long long integer;
+    double real;
+  };
+} Number;
+
+#define NUMBER_BUFFER_SIZE 32
+
+bool number_parse(const char *s, Number *number);
+void number_format(Number number, char *buffer);
+int number_compare(Number a, Number b);
+Number number_add(Number a, Number b);
+bool arithmetic_evaluate(const char *expression, Number *result);
+
+#endif
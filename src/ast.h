@@ -1,21 +1,46 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
 #include "token.h"
 
 typedef enum {
   JOB_COMMAND,
   JOB_BINARY,
   JOB_UNARY,
+  JOB_PIPELINE,
 } Job_Type;
 
 typedef struct {
   Job_Type type;
 } Job;
 
+typedef enum {
+  REDIRECT_INPUT,
+  REDIRECT_OUTPUT,
+  REDIRECT_APPEND,
+  REDIRECT_DUPLICATE,
+} Redirect_Type;
+
+// fd is the descriptor being redirected. it is pointed at the file
+// named by target, or for '>&' at target_fd.
+typedef struct {
+  Redirect_Type type;
+  int fd;
+  int target_fd;
+  Token target;
+} Redirect;
+
+typedef struct {
+  Redirect *ptr;
+  int len;
+  int cap;
+} Redirect_Array;
+
 typedef struct {
   Job_Type type;
   Token_Array argv;
+  Redirect_Array redirects;
 } Job_Command;
 
 typedef struct {
@@ -31,6 +56,19 @@ typedef struct {
   Job *right;
 } Job_Binary;
 
+typedef struct {
+  Job **ptr;
+  int len;
+  int cap;
+} Job_Array;
+
+// 'a | b | c' is kept as one flat list of stages rather than nested
+// binary jobs, so it can be started without intermediate subshells
+typedef struct {
+  Job_Type type;
+  Job_Array stages;
+} Job_Pipeline;
+
 typedef enum {
   STATEMENT_JOB,
   STATEMENT_IF,
@@ -72,6 +110,9 @@ typedef struct {
   Token var_name;
   Token string;
   Token delim;
+  bool from_command;
+  bool parallel;
+  Token workers;
   Statement_Array body;
 } Statement_For;
 
@@ -81,37 +122,16 @@ typedef struct {
   Statement_Array body;
 } Statement_Function;
 
-Job *create_job_binary(Job *left, Token operator, Job *right);
-Job *create_job_unary(Token operator, Job *child);
-Job *create_job_command(Token_Array argv);
-Statement *create_statement_if(Job *condition, Statement_Array ifBranch, Statement_Array elseBranch);
-Statement *create_statement_while(Job *condition, Statement_Array body);
-Statement *create_statement_function(Token name, Statement_Array body);
-Statement *create_statement_for(Token var_name, Token string, Token delim, Statement_Array body);
-Statement *create_statement_job(Job *job);
-
-void free_if_statement(Statement_If *statement);
-void free_while_statement(Statement_While *statement);
-void free_for_statement(Statement_For *statement);
-void free_function_statement(Statement_Function *statement);
-void free_job_statement(Statement_Job *statement);
-void free_statement(Statement *statement);
-void free_statements(Statement_Array *statements);
-void free_job_command(Job_Command *cmd);
-void free_job_unary(Job_Unary *un);
-void free_job_binary(Job_Binary *bin);
-void free_job(Job *job);
-
-Job *clone_job(const Job *job);
-Job *clone_job_binary(const Job_Binary *job);
-Job *clone_job_unary(const Job_Unary *job);
-Job *clone_job_command(const Job_Command *job);
-Statement *clone_statement(Statement *statement);
-Statement_Array clone_statements(Statement_Array statements);
-Statement *clone_statement_function(const Statement_Function *fn);
-Statement *clone_statement_if(const Statement_If *statement);
-Statement *clone_statement_for(const Statement_For *statement);
-Statement *clone_statement_job(const Statement_Job *statement);
-Statement *clone_statement_while(const Statement_While *statement);
+// nodes and their arrays are allocated in an arena and never freed
+// one by one
+Job *create_job_binary(Arena *arena, Job *left, Token operator, Job *right);
+Job *create_job_unary(Arena *arena, Token operator, Job *child);
+Job *create_job_command(Arena *arena, Token_Array argv, Redirect_Array redirects);
+Job *create_job_pipeline(Arena *arena, Job_Array stages);
+Statement *create_statement_if(Arena *arena, Job *condition, Statement_Array ifBranch, Statement_Array elseBranch);
+Statement *create_statement_while(Arena *arena, Job *condition, Statement_Array body);
+Statement *create_statement_function(Arena *arena, Token name, Statement_Array body);
+Statement *create_statement_for(Arena *arena, Token var_name, Token string, Token delim, bool from_command, bool parallel, Token workers, Statement_Array body);
+Statement *create_statement_job(Arena *arena, Job *job);
 
 #endif
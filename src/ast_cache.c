@@ -0,0 +1,568 @@
+#include "ast_cache.h"
+#include "arena.h"
+#include "ast.h"
+#include "libzatar.h"
+#include "source.h"
+#include "state.h"
+#include "token.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// bump this whenever the layout below or the AST changes
+#define AST_CACHE_VERSION 5
+#define AST_CACHE_MAGIC "FLINTAST"
+#define NO_NODE UINT32_MAX
+
+// a cache file is this header, then the text tokens point into (the
+// script itself followed by the text of any alias it expanded), then
+// the statements, written depth first as a stream of uint32 values
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t text_len;
+  uint64_t build_id;
+  uint64_t alias_fingerprint;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  int64_t size;
+  uint32_t path_len;
+  uint32_t nodes_count;
+} Cache_Header;
+
+typedef struct {
+  Z_String text;
+  Z_String nodes;
+  const Source *source;
+} Writer;
+
+typedef struct {
+  const uint32_t *nodes;
+  uint32_t nodes_count;
+  uint32_t next;
+  const Source *source;
+  Arena *arena;
+  bool failed;
+} Reader;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+  const unsigned char *bytes = data;
+
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+// the executable itself identifies the build, relinking changes its
+// mtime and so invalidates everything cached by the old one
+static uint64_t get_build_id()
+{
+  static uint64_t build_id = 0;
+
+  if (build_id == 0) {
+    struct stat st = {0};
+    stat("/proc/self/exe", &st);
+    uint32_t version = AST_CACHE_VERSION;
+    build_id = hash_bytes(14695981039346656037ull, &version, sizeof(version));
+    build_id = hash_bytes(build_id, &st.st_mtim, sizeof(st.st_mtim));
+    build_id = hash_bytes(build_id, &st.st_size, sizeof(st.st_size));
+    build_id = hash_bytes(build_id, &st.st_ino, sizeof(st.st_ino));
+  }
+
+  return build_id;
+}
+
+static bool get_cache_dir(Z_String *dir)
+{
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+
+  if (xdg && *xdg) {
+    z_str_append_format(dir, "%s/flint", xdg);
+  } else if (home && *home) {
+    z_str_append_format(dir, "%s/.cache/flint", home);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static bool get_cache_path(const char *path, Z_String *cache_path)
+{
+  if (!get_cache_dir(cache_path)) {
+    return false;
+  }
+
+  uint64_t hash = hash_bytes(14695981039346656037ull, path, strlen(path));
+  z_str_append_format(cache_path, "/%016llx.ast", (unsigned long long)hash);
+
+  return true;
+}
+
+static Cache_Header make_header(const char *path, const struct stat *st)
+{
+  Cache_Header header = {0};
+  memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+  header.version = AST_CACHE_VERSION;
+  header.build_id = get_build_id();
+  header.alias_fingerprint = select_alias_fingerprint();
+  header.mtime_sec = st->st_mtim.tv_sec;
+  header.mtime_nsec = st->st_mtim.tv_nsec;
+  header.size = st->st_size;
+  header.path_len = strlen(path);
+
+  return header;
+}
+
+// z_str_append_str formats with %.*s, which stops at the first NUL
+static void append_bytes(Z_String *buffer, const void *data, int len)
+{
+  z_da_ensure_capacity(buffer, buffer->len + len);
+  memcpy(buffer->ptr + buffer->len, data, len);
+  buffer->len += len;
+}
+
+static void write_u32(Writer *writer, uint32_t value)
+{
+  append_bytes(&writer->nodes, &value, sizeof(value));
+}
+
+// lexemes from the script are stored as offsets into it, the ones an
+// alias expansion produced are appended to the text first
+static void write_token(Writer *writer, Token token)
+{
+  const char *text = writer->source->text;
+  uint32_t offset;
+
+  if (token.lexeme.ptr >= text && token.lexeme.ptr + token.lexeme.len <= text + writer->source->len) {
+    offset = token.lexeme.ptr - text;
+  } else {
+    offset = writer->text.len;
+    append_bytes(&writer->text, token.lexeme.ptr, token.lexeme.len);
+  }
+
+  write_u32(writer, token.type);
+  write_u32(writer, offset);
+  write_u32(writer, token.lexeme.len);
+  write_u32(writer, token.line);
+  write_u32(writer, token.column);
+}
+
+static void write_statements(Writer *writer, Statement_Array statements);
+
+static void write_job(Writer *writer, const Job *job)
+{
+  if (!job) {
+    write_u32(writer, NO_NODE);
+    return;
+  }
+
+  write_u32(writer, job->type);
+
+  switch (job->type) {
+    case JOB_COMMAND: {
+      const Job_Command *command = (const Job_Command *)job;
+      write_u32(writer, command->argv.len);
+      z_da_foreach(Token *, token, &command->argv) {
+        write_token(writer, *token);
+      }
+      write_u32(writer, command->redirects.len);
+      z_da_foreach(Redirect *, redirect, &command->redirects) {
+        write_u32(writer, redirect->type);
+        write_u32(writer, redirect->fd);
+        write_u32(writer, redirect->target_fd);
+        write_token(writer, redirect->target);
+      }
+      break;
+    }
+
+    case JOB_UNARY: {
+      const Job_Unary *unary = (const Job_Unary *)job;
+      write_token(writer, unary->operator);
+      write_job(writer, unary->child);
+      break;
+    }
+
+    case JOB_BINARY: {
+      const Job_Binary *binary = (const Job_Binary *)job;
+      write_token(writer, binary->operator);
+      write_job(writer, binary->left);
+      write_job(writer, binary->right);
+      break;
+    }
+
+    case JOB_PIPELINE: {
+      const Job_Pipeline *pipeline = (const Job_Pipeline *)job;
+      write_u32(writer, pipeline->stages.len);
+      z_da_foreach(Job **, stage, &pipeline->stages) {
+        write_job(writer, *stage);
+      }
+      break;
+    }
+  }
+}
+
+static void write_statement(Writer *writer, const Statement *statement)
+{
+  write_u32(writer, statement->type);
+
+  switch (statement->type) {
+    case STATEMENT_JOB:
+      write_job(writer, ((const Statement_Job *)statement)->job);
+      break;
+
+    case STATEMENT_IF: {
+      const Statement_If *node = (const Statement_If *)statement;
+      write_job(writer, node->condition);
+      write_statements(writer, node->ifBranch);
+      write_statements(writer, node->elseBranch);
+      break;
+    }
+
+    case STATEMENT_WHILE: {
+      const Statement_While *node = (const Statement_While *)statement;
+      write_job(writer, node->condition);
+      write_statements(writer, node->body);
+      break;
+    }
+
+    case STATEMENT_FOR: {
+      const Statement_For *node = (const Statement_For *)statement;
+      write_token(writer, node->var_name);
+      write_token(writer, node->string);
+      write_token(writer, node->delim);
+      write_u32(writer, node->from_command);
+      write_u32(writer, node->parallel);
+      write_token(writer, node->workers);
+      write_statements(writer, node->body);
+      break;
+    }
+
+    case STATEMENT_FUNCTION: {
+      const Statement_Function *node = (const Statement_Function *)statement;
+      write_token(writer, node->name);
+      write_statements(writer, node->body);
+      break;
+    }
+  }
+}
+
+static void write_statements(Writer *writer, Statement_Array statements)
+{
+  write_u32(writer, statements.len);
+
+  z_da_foreach(Statement **, statement, &statements) {
+    write_statement(writer, *statement);
+  }
+}
+
+static uint32_t read_u32(Reader *reader)
+{
+  if (reader->next >= reader->nodes_count) {
+    reader->failed = true;
+    return 0;
+  }
+
+  return reader->nodes[reader->next++];
+}
+
+static Token read_token(Reader *reader)
+{
+  Token token = {0};
+  token.type = read_u32(reader);
+  uint32_t offset = read_u32(reader);
+  uint32_t len = read_u32(reader);
+  token.line = read_u32(reader);
+  token.column = read_u32(reader);
+
+  if ((uint64_t)offset + len > reader->source->len) {
+    reader->failed = true;
+    return token;
+  }
+
+  token.lexeme = (Z_String_View){ .ptr = reader->source->text + offset, .len = len };
+
+  return token;
+}
+
+static Statement_Array read_statements(Reader *reader);
+
+static Job *read_job(Reader *reader)
+{
+  uint32_t type = read_u32(reader);
+
+  if (reader->failed || type == NO_NODE) {
+    return NULL;
+  }
+
+  switch (type) {
+    case JOB_COMMAND: {
+      Token_Array argv = {0};
+      uint32_t count = read_u32(reader);
+
+      for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        arena_da_append(reader->arena, &argv, read_token(reader));
+      }
+
+      Redirect_Array redirects = {0};
+      count = read_u32(reader);
+
+      for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        Redirect redirect = {0};
+        redirect.type = read_u32(reader);
+        redirect.fd = read_u32(reader);
+        redirect.target_fd = read_u32(reader);
+        redirect.target = read_token(reader);
+        arena_da_append(reader->arena, &redirects, redirect);
+      }
+
+      return create_job_command(reader->arena, argv, redirects);
+    }
+
+    case JOB_UNARY: {
+      Token operator = read_token(reader);
+      Job *child = read_job(reader);
+      return create_job_unary(reader->arena, operator, child);
+    }
+
+    case JOB_BINARY: {
+      Token operator = read_token(reader);
+      Job *left = read_job(reader);
+      Job *right = read_job(reader);
+      return create_job_binary(reader->arena, left, operator, right);
+    }
+
+    case JOB_PIPELINE: {
+      Job_Array stages = {0};
+      uint32_t count = read_u32(reader);
+
+      for (uint32_t i = 0; i < count && !reader->failed; i++) {
+        Job *stage = read_job(reader);
+        reader->failed |= stage == NULL;
+        arena_da_append(reader->arena, &stages, stage);
+      }
+
+      return create_job_pipeline(reader->arena, stages);
+    }
+
+    default:
+      reader->failed = true;
+      return NULL;
+  }
+}
+
+static Statement *read_statement(Reader *reader)
+{
+  uint32_t type = read_u32(reader);
+
+  switch (type) {
+    case STATEMENT_JOB:
+      return create_statement_job(reader->arena, read_job(reader));
+
+    case STATEMENT_IF: {
+      Job *condition = read_job(reader);
+      Statement_Array ifBranch = read_statements(reader);
+      Statement_Array elseBranch = read_statements(reader);
+      return create_statement_if(reader->arena, condition, ifBranch, elseBranch);
+    }
+
+    case STATEMENT_WHILE: {
+      Job *condition = read_job(reader);
+      Statement_Array body = read_statements(reader);
+      return create_statement_while(reader->arena, condition, body);
+    }
+
+    case STATEMENT_FOR: {
+      Token var_name = read_token(reader);
+      Token string = read_token(reader);
+      Token delim = read_token(reader);
+      bool from_command = read_u32(reader);
+      bool parallel = read_u32(reader);
+      Token workers = read_token(reader);
+      Statement_Array body = read_statements(reader);
+      return create_statement_for(reader->arena, var_name, string, delim, from_command, parallel, workers, body);
+    }
+
+    case STATEMENT_FUNCTION: {
+      Token name = read_token(reader);
+      Statement_Array body = read_statements(reader);
+      return create_statement_function(reader->arena, name, body);
+    }
+
+    default:
+      reader->failed = true;
+      return NULL;
+  }
+}
+
+static Statement_Array read_statements(Reader *reader)
+{
+  Statement_Array statements = {0};
+  uint32_t count = read_u32(reader);
+
+  for (uint32_t i = 0; i < count && !reader->failed; i++) {
+    Statement *statement = read_statement(reader);
+
+    if (!reader->failed) {
+      arena_da_append(reader->arena, &statements, statement);
+    }
+  }
+
+  return statements;
+}
+
+static bool is_valid_header(const Cache_Header *cached, const Cache_Header *expected, size_t file_size)
+{
+  if (memcmp(cached, expected, offsetof(Cache_Header, text_len))
+      || cached->build_id != expected->build_id
+      || cached->alias_fingerprint != expected->alias_fingerprint
+      || cached->mtime_sec != expected->mtime_sec
+      || cached->mtime_nsec != expected->mtime_nsec
+      || cached->size != expected->size
+      || cached->path_len != expected->path_len) {
+    return false;
+  }
+
+  size_t expected_size = sizeof(Cache_Header) + cached->path_len + cached->text_len
+    + (size_t)cached->nodes_count * sizeof(uint32_t);
+
+  return file_size == expected_size;
+}
+
+bool ast_cache_load(const char *path, const struct stat *st, Arena *arena, Source **source, Statement_Array *statements)
+{
+  Z_String cache_path = {0};
+
+  if (!get_cache_path(path, &cache_path)) {
+    return false;
+  }
+
+  int fd = open(z_str_to_cstr(&cache_path), O_RDONLY | O_CLOEXEC);
+  z_str_free(&cache_path);
+
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat cache_st;
+
+  if (fstat(fd, &cache_st) == -1 || (size_t)cache_st.st_size < sizeof(Cache_Header)) {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const Cache_Header *header = map;
+  Cache_Header expected = make_header(path, st);
+  const char *cached_path = (const char *)(header + 1);
+  bool loaded = false;
+
+  if (is_valid_header(header, &expected, cache_st.st_size) && !memcmp(cached_path, path, header->path_len)) {
+    const char *text = cached_path + header->path_len;
+
+    Reader reader = {
+      .nodes = (const uint32_t *)(text + header->text_len),
+      .nodes_count = header->nodes_count,
+      .next = 0,
+      .source = source_create((Z_String_View){ .ptr = text, .len = header->text_len }),
+      .arena = arena,
+      .failed = false,
+    };
+
+    Statement_Array loaded_statements = read_statements(&reader);
+    loaded = !reader.failed && reader.next == reader.nodes_count;
+
+    if (loaded) {
+      *source = (Source *)reader.source;
+      *statements = loaded_statements;
+    } else {
+      source_release((Source *)reader.source);
+    }
+  }
+
+  munmap(map, cache_st.st_size);
+
+  return loaded;
+}
+
+static void make_dirs(char *path)
+{
+  for (char *p = path + 1; *p; p++) {
+    if (*p == '/') {
+      *p = '\0';
+      mkdir(path, 0755);
+      *p = '/';
+    }
+  }
+
+  mkdir(path, 0755);
+}
+
+// written to a temporary file and renamed into place, so a concurrent
+// flint never maps a half written cache
+void ast_cache_store(const char *path, const struct stat *st, const Source *source, Statement_Array statements)
+{
+  Z_String dir = {0};
+  Z_String cache_path = {0};
+
+  if (!get_cache_dir(&dir) || !get_cache_path(path, &cache_path)) {
+    z_str_free(&dir);
+    z_str_free(&cache_path);
+    return;
+  }
+
+  make_dirs((char *)z_str_to_cstr(&dir));
+
+  Writer writer = { .text = {0}, .nodes = {0}, .source = source };
+  append_bytes(&writer.text, source->text, source->len);
+  write_statements(&writer, statements);
+
+  // keeps the nodes that follow the text aligned
+  while ((sizeof(Cache_Header) + strlen(path) + writer.text.len) % sizeof(uint32_t)) {
+    append_bytes(&writer.text, "", 1);
+  }
+
+  Cache_Header header = make_header(path, st);
+  header.text_len = writer.text.len;
+  header.nodes_count = writer.nodes.len / sizeof(uint32_t);
+
+  Z_String tmp_path = {0};
+  z_str_append_format(&tmp_path, "%s.%d.tmp", z_str_to_cstr(&cache_path), getpid());
+  FILE *fp = fopen(z_str_to_cstr(&tmp_path), "wb");
+
+  if (fp) {
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+      && fwrite(path, 1, header.path_len, fp) == header.path_len
+      && fwrite(writer.text.ptr, 1, writer.text.len, fp) == (size_t)writer.text.len
+      && fwrite(writer.nodes.ptr, 1, writer.nodes.len, fp) == (size_t)writer.nodes.len;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(z_str_to_cstr(&tmp_path), z_str_to_cstr(&cache_path)) == -1) {
+      unlink(z_str_to_cstr(&tmp_path));
+    }
+  }
+
+  z_str_free(&tmp_path);
+  z_str_free(&writer.text);
+  z_str_free(&writer.nodes);
+  z_str_free(&dir);
+  z_str_free(&cache_path);
+}
@@ -0,0 +1,15 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include "arena.h"
+#include "ast.h"
+#include "source.h"
+#include <stdbool.h>
+#include <sys/stat.h>
+
+// parsed scripts are cached on disk, keyed by the script's path, mtime
+// and size, the flint build and the aliases it was expanded against
+bool ast_cache_load(const char *path, const struct stat *st, Arena *arena, Source **source, Statement_Array *statements);
+void ast_cache_store(const char *path, const struct stat *st, const Source *source, Statement_Array statements);
+
+#endif
@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../libzatar.h"
+#include "../spawn.h"
+#include "../state.h"
+#include "../worker_pool.h"
+
+#define READ_SIZE (64 * 1024)
+
+// room left for what the kernel and the dynamic loader add to the stack
+#define ARGUMENT_HEADROOM 4096
+
+// linux also limits every single argument to 32 pages (MAX_ARG_STRLEN)
+#define MAX_ARGUMENT_PAGES 32
+
+extern char **environ;
+
+typedef struct {
+    char **ptr;
+    int len;
+    int cap;
+} Items;
+
+static void usage()
+{
+    fprintf(stderr, "Usage: batch [-P workers] [-n items] [-d delimiters] [-v variable] <command> [args...]\n");
+}
+
+static bool read_input(Z_String *input)
+{
+    ssize_t n;
+
+    do {
+        z_da_ensure_capacity(input, input->len + READ_SIZE + 1);
+        n = read(STDIN_FILENO, input->ptr + input->len, READ_SIZE);
+
+        if (n > 0) {
+            input->len += n;
+        }
+    } while (n > 0 || (n < 0 && errno == EINTR));
+
+    input->ptr[input->len] = '\0';
+
+    return n == 0;
+}
+
+// splits text in place, empty items are skipped
+static void split_items(char *text, const char *delimiters, Items *items)
+{
+    text += strspn(text, delimiters);
+
+    while (*text) {
+        z_da_append(items, text);
+        text += strcspn(text, delimiters);
+
+        if (*text) {
+            *text++ = '\0';
+            text += strspn(text, delimiters);
+        }
+    }
+}
+
+// the arguments and environment of an exec share ARG_MAX, each string
+// also takes a pointer in the argv or envp array
+static long argument_space()
+{
+    long space = sysconf(_SC_ARG_MAX) - ARGUMENT_HEADROOM;
+
+    for (char **env = environ; *env; env++) {
+        space -= strlen(*env) + 1 + sizeof(char *);
+    }
+
+    return space;
+}
+
+static long argument_size(const char *argument)
+{
+    return strlen(argument) + 1 + sizeof(char *);
+}
+
+static int run_batch(char **argv, Worker_Pool *pool)
+{
+    if (!pool) {
+        return spawn_and_wait(argv, NULL);
+    }
+
+    worker_pool_spawn(pool, argv);
+
+    return 0;
+}
+
+// the value of an option is the rest of its word, as in '-P4', or the
+// next word. NULL if there is none.
+static const char *option_value(int argc, char **argv, int *i)
+{
+    if (argv[*i][2] != '\0') {
+        return argv[*i] + 2;
+    }
+
+    if (*i + 1 >= argc) {
+        return NULL;
+    }
+
+    (*i)++;
+
+    return argv[*i];
+}
+
+// runs command with as many items as fit in one exec at a time, or at
+// most -n of them, and not at all without items. with -P the batches
+// run in up to that many processes, their output in order. the status
+// is the one of the first batch that failed. options take their value
+// in the same word or the next one.
+int builtin_batch(int argc, char **argv)
+{
+    const char *delimiters = " \t\n";
+    const char *variable = NULL;
+    int workers = 1;
+    int max_items = 0;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] && strchr("Pndv", argv[i][1]); i++) {
+        char option = argv[i][1];
+        const char *value = option_value(argc, argv, &i);
+
+        if (!value) {
+            usage();
+            return 1;
+        }
+
+        switch (option) {
+            case 'P': workers = atoi(value); break;
+            case 'n': max_items = atoi(value); break;
+            case 'd': delimiters = value; break;
+            case 'v': variable = value; break;
+        }
+    }
+
+    if (i >= argc || workers < 1 || max_items < 0) {
+        usage();
+        return 1;
+    }
+
+    Z_String input = {0};
+
+    if (variable) {
+        const char *value = select_variable(variable);
+        int len = value ? strlen(value) : 0;
+        z_da_ensure_capacity(&input, len + 1);
+        memcpy(input.ptr, value ? value : "", len + 1);
+        input.len = len;
+    } else if (!read_input(&input)) {
+        fprintf(stderr, "batch: %s\n", strerror(errno));
+        z_str_free(&input);
+        return 1;
+    }
+
+    Items items = {0};
+    split_items(input.ptr, delimiters, &items);
+
+    int command_len = argc - i;
+    long command_size = 0;
+
+    for (int j = i; j < argc; j++) {
+        command_size += argument_size(argv[j]);
+    }
+
+    char **batch = malloc((command_len + items.len + 1) * sizeof(char *));
+    memcpy(batch, argv + i, command_len * sizeof(char *));
+
+    Worker_Pool *pool = workers > 1 ? worker_pool_create(workers) : NULL;
+    long space = argument_space();
+    long max_length = sysconf(_SC_PAGESIZE) * MAX_ARGUMENT_PAGES;
+    int status = 0;
+    int next = 0;
+
+    while (next < items.len) {
+        if ((long)strlen(items.ptr[next]) >= max_length) {
+            fprintf(stderr, "batch: '%.20s...': argument too long\n", items.ptr[next]);
+            status = status ? status : 1;
+            next++;
+            continue;
+        }
+
+        long size = command_size;
+        int len = command_len;
+
+        while (next < items.len && (max_items == 0 || len - command_len < max_items)
+               && (long)strlen(items.ptr[next]) < max_length
+               && (len == command_len || size + argument_size(items.ptr[next]) <= space)) {
+            size += argument_size(items.ptr[next]);
+            batch[len++] = items.ptr[next++];
+        }
+
+        if (size > space) {
+            fprintf(stderr, "batch: '%.20s...': argument list too long\n", batch[len - 1]);
+            status = status ? status : 1;
+            continue;
+        }
+
+        batch[len] = NULL;
+        int batch_status = run_batch(batch, pool);
+        status = status ? status : batch_status;
+    }
+
+    if (pool) {
+        int pool_status = worker_pool_finish(pool);
+        status = status ? status : pool_status;
+    }
+
+    free(batch);
+    z_da_free(&items);
+    z_str_free(&input);
+
+    return status;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include "../job_table.h"
+
+int builtin_bg(int argc, char **argv)
+{
+    if (argc > 2) {
+        fprintf(stderr, "Usage: bg [%%job]\n");
+        return 1;
+    }
+
+    jobs_reap();
+    Job_Entry *entry = jobs_find(argc == 2 ? argv[1] : NULL);
+
+    if (!entry) {
+        fprintf(stderr, "bg: %s: no such job\n", argc == 2 ? argv[1] : "current");
+        return 1;
+    }
+
+    jobs_background(entry);
+
+    return 0;
+}
@@ -7,34 +7,105 @@
 
 int safe_fork();
 
+// pure builtins don't read their input or change the shell's state,
+// so as a pipeline stage they can run in the shell instead of a fork
+#define BUILTINS         \
+    X(cd, false)         \
+    X(exit, false)       \
+    X(alias, false)      \
+    X(export, false)     \
+    X(mut, false)        \
+    X(let, false)        \
+    X(test, true)        \
+    X(len, true)         \
+    X(print, true)       \
+    X(println, true)     \
+    X(time, false)       \
+    X(command, false)    \
+    X(hash, false)       \
+    X(jobs, false)       \
+    X(wait, false)       \
+    X(fg, false)         \
+    X(bg, false)         \
+    X(batch, false)      \
+    X(math, false)       \
+    X(inc, false)        \
+    X(push, false)       \
+    X(read, false)       \
+    X(readlines, false)
+
 typedef struct {
     const char *name;
     BuiltinFn function;
+    bool pure;
 } Builtin;
 
-static Builtin builtins[] = {
-    { .name = "cd", .function = builtin_cd },
-    { .name = "exit", .function = builtin_exit },
-    { .name = "alias", .function = builtin_alias },
-    { .name = "export", .function = builtin_export },
-    { .name = "mut", .function = builtin_mut },
-    { .name = "let", .function = builtin_let },
-    { .name = "test", .function = builtin_test },
-    { .name = "len", .function = builtin_len },
-    { .name = "print", .function = builtin_print },
-    { .name = "println", .function = builtin_println },
-    { .name = "time", .function = builtin_time },
-    { .name = "command", .function = builtin_command },
+static const Builtin builtins[] = {
+#define X(builtin, is_pure) { .name = #builtin, .function = builtin_##builtin, .pure = is_pure },
+    BUILTINS
+#undef X
 };
 
-BuiltinFn get_builtin(const char *name)
+#define BUILTIN_SLOTS 64
+
+_Static_assert(sizeof(builtins) / sizeof(builtins[0]) < BUILTIN_SLOTS,
+    "builtins need an empty slot to end a probe");
+
+// the hash has no collisions for the names above, so a lookup usually
+// checks a single slot. a new builtin that collides takes the next free
+// slot, and lookups probe until an empty one.
+static const Builtin *slots[BUILTIN_SLOTS];
+static bool slots_filled = false;
+
+static unsigned hash_name(const char *name, size_t len)
+{
+    return (len + (unsigned char)name[0] * 5 + (unsigned char)name[len - 1] * 22) % BUILTIN_SLOTS;
+}
+
+static void fill_slots()
 {
     for (int i = 0; i < (int)(sizeof(builtins) / sizeof(builtins[0])); i++) {
-        if (strcmp(builtins[i].name, name) == 0) {
-            return builtins[i].function;
+        unsigned slot = hash_name(builtins[i].name, strlen(builtins[i].name));
+
+        while (slots[slot]) {
+            slot = (slot + 1) % BUILTIN_SLOTS;
+        }
+
+        slots[slot] = &builtins[i];
+    }
+
+    slots_filled = true;
+}
+
+static const Builtin *find_builtin(const char *name)
+{
+    if (!slots_filled) {
+        fill_slots();
+    }
+
+    size_t len = strlen(name);
+
+    if (len == 0) {
+        return NULL;
+    }
+
+    for (unsigned slot = hash_name(name, len); slots[slot]; slot = (slot + 1) % BUILTIN_SLOTS) {
+        if (strcmp(slots[slot]->name, name) == 0) {
+            return slots[slot];
         }
     }
 
     return NULL;
 }
 
+BuiltinFn get_builtin(const char *name)
+{
+    const Builtin *builtin = find_builtin(name);
+    return builtin ? builtin->function : NULL;
+}
+
+BuiltinFn get_pure_builtin(const char *name)
+{
+    const Builtin *builtin = find_builtin(name);
+    return builtin && builtin->pure ? builtin->function : NULL;
+}
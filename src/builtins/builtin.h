@@ -7,6 +7,7 @@
 typedef int (*BuiltinFn)(int argc, char **argv);
 
 BuiltinFn get_builtin(const char *name);
+BuiltinFn get_pure_builtin(const char *name);
 
 int builtin_cd(int argc, char **argv);
 int builtin_exit(int argc, char **argv);
@@ -19,6 +20,17 @@ int builtin_print(int argc, char **argv);
 int builtin_println(int argc, char **argv);
 int builtin_time(int argc, char **argv);
 int builtin_command(int argc, char **argv);
+int builtin_hash(int argc, char **argv);
+int builtin_jobs(int argc, char **argv);
+int builtin_wait(int argc, char **argv);
+int builtin_fg(int argc, char **argv);
+int builtin_bg(int argc, char **argv);
+int builtin_batch(int argc, char **argv);
+int builtin_math(int argc, char **argv);
+int builtin_inc(int argc, char **argv);
+int builtin_push(int argc, char **argv);
+int builtin_read(int argc, char **argv);
+int builtin_readlines(int argc, char **argv);
 
 const char *get_alias(Z_String_View key);
 void add_alias(Z_String_View key, Z_String_View value);
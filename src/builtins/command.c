@@ -1,6 +1,5 @@
 #include <stdio.h>
-#include <sys/wait.h>
-#include <unistd.h>
+#include "../spawn.h"
 
 int builtin_command(int argc, char **argv)
 {
@@ -9,17 +8,5 @@ int builtin_command(int argc, char **argv)
         return 1;
     }
 
-    int status = 0;
-    int pid = fork();
-
-    if (pid < 0) {
-        fprintf(stderr, "Fork failed\n");
-    } else if (pid == 0) {
-        execvp(argv[1], argv + 1);
-    } else {
-        waitpid(pid, &status, 0);
-        return status;
-    }
-
-    return status;
+    return spawn_and_wait(argv + 1, NULL);
 }
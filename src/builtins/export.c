@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "../command_hash.h"
 
 int builtin_export(int argc, char **argv)
 {
@@ -8,5 +10,9 @@ int builtin_export(int argc, char **argv)
         return 1;
     }
 
+    if (!strcmp(argv[1], "PATH")) {
+        hash_clear_commands();
+    }
+
     return setenv(argv[1], argv[2], 1);
 }
@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <sys/wait.h>
+#include "../job_table.h"
+
+int builtin_fg(int argc, char **argv)
+{
+    if (argc > 2) {
+        fprintf(stderr, "Usage: fg [%%job]\n");
+        return W_EXITCODE(1, 0);
+    }
+
+    jobs_reap();
+    Job_Entry *entry = jobs_find(argc == 2 ? argv[1] : NULL);
+
+    if (!entry) {
+        fprintf(stderr, "fg: %s: no such job\n", argc == 2 ? argv[1] : "current");
+        return W_EXITCODE(1, 0);
+    }
+
+    return jobs_foreground(entry);
+}
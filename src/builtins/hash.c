@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <string.h>
+#include "../command_hash.h"
+
+int builtin_hash(int argc, char **argv)
+{
+    if (argc == 1) {
+        hash_print_commands();
+        return 0;
+    }
+
+    if (argc == 2 && !strcmp(argv[1], "-r")) {
+        hash_clear_commands();
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "-r")) {
+        fprintf(stderr, "Usage: hash [-r] [command...]\n");
+        return 1;
+    }
+
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!hash_lookup_command(argv[i])) {
+            fprintf(stderr, "hash: %s: not found\n", argv[i]);
+            status = 1;
+        }
+    }
+
+    return status;
+}
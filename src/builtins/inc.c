@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include "../arithmetic.h"
+#include "../state.h"
+
+// adds to the number a variable holds without reparsing it, the
+// variable keeps its parsed value for the next time
+int builtin_inc(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: inc <variable_name> [amount]\n");
+        return 1;
+    }
+
+    const char *name = argv[1];
+    Number amount = { .integer = 1 };
+    Number value;
+
+    if (argc == 3 && !number_parse(argv[2], &amount)) {
+        fprintf(stderr, "inc: '%s': not a number\n", argv[2]);
+        return 1;
+    }
+
+    if (!select_variable_number(name, &value)) {
+        fprintf(stderr, "inc: '%s': variable doesn't hold a number\n", name);
+        return 1;
+    }
+
+    if (!action_mutate_number(name, number_add(value, amount))) {
+        fprintf(stderr, "Flint: inc: variable '%s' doesn't exists\n", name);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include "../job_table.h"
+#include "../output.h"
+
+int builtin_jobs(int argc, char **argv)
+{
+    (void)argv;
+
+    if (argc != 1) {
+        fprintf(stderr, "Usage: jobs\n");
+        return 1;
+    }
+
+    jobs_print(output_stream());
+
+    return 0;
+}
@@ -1,14 +1,32 @@
 #include <stdio.h>
 #include <string.h>
+#include "../output.h"
+#include "../state.h"
 
+// with -v the length of a variable: the number of items of a list, the
+// number of characters of anything else
 int builtin_len(int argc, char **argv)
 {
+    if (argc == 3 && !strcmp(argv[1], "-v")) {
+        Value *variable = select_variable_value(argv[2]);
+
+        if (!variable) {
+            fprintf(stderr, "Flint: len: variable '%s' doesn't exists\n", argv[2]);
+            return 1;
+        }
+
+        int length = variable->type == VALUE_LIST ? variable->list.len : (int)strlen(value_text(variable));
+        fprintf(output_stream(), "%d\n", length);
+
+        return 0;
+    }
+
     if (argc != 2) {
-        fprintf(stderr, "Usage: len <value>\n");
+        fprintf(stderr, "Usage: len <value> | len -v <variable_name>\n");
         return 1;
     }
 
-    printf("%zu\n", strlen(argv[1]));
+    fprintf(output_stream(), "%zu\n", strlen(argv[1]));
 
     return 0;
 }
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include "../arithmetic.h"
+#include "../libzatar.h"
+#include "../output.h"
+
+// the arguments are joined with spaces, so 'math 1 + 2' and
+// 'math "1 + 2"' are the same expression
+int builtin_math(int argc, char **argv)
+{
+    if (argc == 1) {
+        fprintf(stderr, "Usage: math <expression>\n");
+        return 1;
+    }
+
+    Z_String expression = {0};
+
+    for (int i = 1; i < argc; i++) {
+        z_str_append_format(&expression, "%s%s", i > 1 ? " " : "", argv[i]);
+    }
+
+    Number result;
+    bool ok = arithmetic_evaluate(z_str_to_cstr(&expression), &result);
+    z_str_free(&expression);
+
+    if (!ok) {
+        return 1;
+    }
+
+    char buffer[NUMBER_BUFFER_SIZE];
+    number_format(result, buffer);
+    fprintf(output_stream(), "%s\n", buffer);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include "../output.h"
 
 int builtin_print(int argc, char **argv)
 {
@@ -7,7 +8,7 @@ int builtin_print(int argc, char **argv)
         return 1;
     }
 
-    printf("%s", argv[1]);
+    fputs(argv[1], output_stream());
 
     return 0;
 }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include "../output.h"
 
 int builtin_println(int argc, char **argv)
 {
@@ -7,7 +8,9 @@ int builtin_println(int argc, char **argv)
         return 1;
     }
 
-    printf("%s\n", argv[1]);
+    FILE *stream = output_stream();
+    fputs(argv[1], stream);
+    fputc('\n', stream);
 
     return 0;
 }
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include "../state.h"
+
+// appends items to a list variable, a variable holding a string
+// becomes a list with the string as its first item
+int builtin_push(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: push <variable_name> <items...>\n");
+        return 1;
+    }
+
+    const char *name = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        if (!action_push_item(name, argv[i])) {
+            fprintf(stderr, "Flint: push: variable '%s' doesn't exists\n", name);
+            fprintf(stderr, "Flint: declare like this: let %s \"\"\n", name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
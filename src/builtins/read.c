@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../record_reader.h"
+#include "../state.h"
+
+// stdin is read through one reader that is kept between calls, so a
+// loop of reads costs a large read now and then instead of a syscall
+// per byte. it's dropped once stdin is something else. a file is read
+// with pread and stdin's offset put right after each record, so a
+// command reading stdin next starts where read stopped. a pipe can't
+// be put back: whatever the reader buffered is only seen by later
+// reads.
+static Record_Reader *reader = NULL;
+static dev_t reader_dev;
+static ino_t reader_ino;
+
+static Record_Reader *stdin_reader(Z_String_View delimiters)
+{
+    struct stat st;
+
+    if (fstat(STDIN_FILENO, &st) < 0) {
+        perror("read");
+        return NULL;
+    }
+
+    off_t offset = S_ISREG(st.st_mode) ? lseek(STDIN_FILENO, 0, SEEK_CUR) : -1;
+
+    if (reader && st.st_dev == reader_dev && st.st_ino == reader_ino
+        && (offset < 0 || offset == record_reader_position(reader))) {
+        record_reader_set_delimiters(reader, delimiters);
+        return reader;
+    }
+
+    if (reader) {
+        record_reader_free(reader);
+    }
+
+    reader = record_reader_create(STDIN_FILENO, delimiters, offset);
+    reader_dev = st.st_dev;
+    reader_ino = st.st_ino;
+
+    return reader;
+}
+
+// at the end of the input the reader is dropped, the end of a terminal
+// only lasts until the next line is typed
+static void drop_reader()
+{
+    record_reader_free(reader);
+    reader = NULL;
+}
+
+static void put_back(Record_Reader *reader)
+{
+    off_t position = record_reader_position(reader);
+
+    if (position >= 0) {
+        lseek(STDIN_FILENO, position, SEEK_SET);
+    }
+}
+
+// sets a variable that exists, declares it in the current scope otherwise
+static void assign(const char *name, const char *value)
+{
+    if (!action_mutate_variable(name, value)) {
+        action_create_variable(name, value);
+    }
+}
+
+// -d sets the delimiters, any of which ends a record, -0 makes it NUL.
+// returns the index of the variable name, 0 on a usage error.
+static int parse_options(int argc, char **argv, Z_String_View *delimiters)
+{
+    *delimiters = Z_CSTR("\n");
+    int i = 1;
+
+    for (; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc - 1) {
+            i++;
+            *delimiters = Z_CSTR(argv[i]);
+        } else if (!strcmp(argv[i], "-0")) {
+            *delimiters = Z_SV("\0", 1);
+        } else {
+            return 0;
+        }
+    }
+
+    return i == argc - 1 ? i : 0;
+}
+
+// fails at the end of the input, with the variable set to ""
+int builtin_read(int argc, char **argv)
+{
+    Z_String_View delimiters;
+    int name = parse_options(argc, argv, &delimiters);
+
+    if (name == 0) {
+        fprintf(stderr, "Usage: read [-d delimiters] [-0] <variable_name>\n");
+        return 1;
+    }
+
+    Record_Reader *records = stdin_reader(delimiters);
+    Z_String_View record;
+
+    if (!records) {
+        assign(argv[name], "");
+        return 1;
+    }
+
+    if (!record_reader_next(records, &record)) {
+        put_back(records);
+        drop_reader();
+        assign(argv[name], "");
+        return 1;
+    }
+
+    put_back(records);
+    assign(argv[name], record.ptr);
+
+    return 0;
+}
+
+// reads every remaining record into a list
+int builtin_readlines(int argc, char **argv)
+{
+    Z_String_View delimiters;
+    int name = parse_options(argc, argv, &delimiters);
+
+    if (name == 0) {
+        fprintf(stderr, "Usage: readlines [-d delimiters] [-0] <variable_name>\n");
+        return 1;
+    }
+
+    Record_Reader *records = stdin_reader(delimiters);
+
+    if (!records) {
+        return 1;
+    }
+
+    Z_String_View record;
+    assign(argv[name], "");
+
+    while (record_reader_next(records, &record)) {
+        action_push_item(argv[name], record.ptr);
+    }
+
+    put_back(records);
+    drop_reader();
+
+    return 0;
+}
@@ -3,16 +3,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-
-static bool is_number(const char *s)
-{
-    if (!*s) return false;
-
-    char *endptr;
-    strtod(s, &endptr);
-
-    return s != endptr && *endptr == '\0';
-}
+#include "../arithmetic.h"
 
 static bool compare(int cmp, const char *operator)
 {
@@ -39,11 +30,13 @@ int builtin_test(int argc, char **argv)
     const char *operator = argv[2];
     const char *b = argv[3];
 
-    bool is_a_number = is_number(a);
-    bool is_b_number = is_number(b);
+    Number x;
+    Number y;
+    bool is_a_number = number_parse(a, &x);
+    bool is_b_number = number_parse(b, &y);
 
     if (is_a_number && is_b_number) {
-        return !compare(strtod(a, NULL) - strtod(b, NULL), operator);
+        return !compare(number_compare(x, y), operator);
     } else if (is_a_number || is_b_number) {
         fprintf(stderr, "Both operands needs to be in the same type: string | number\n");
         return 1;
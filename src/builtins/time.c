@@ -1,6 +1,7 @@
 #include <time.h>
 #include <stdio.h>
 #include "../eval.h"
+#include "../output.h"
 #include <sys/time.h>
 
 int builtin_time(int argc, char **argv)
@@ -14,12 +15,12 @@ int builtin_time(int argc, char **argv)
     struct timeval end;
 
     gettimeofday(&start, NULL);
-    int ret = exec_command(argv + 1);
+    int ret = exec_command(argv + 1, NULL);
     gettimeofday(&end, NULL);
 
     double elapsed_time = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
 
-    printf("%lf\n", elapsed_time);
+    fprintf(output_stream(), "%lf\n", elapsed_time);
 
     return ret;
 }
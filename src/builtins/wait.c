@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <sys/wait.h>
+#include "../job_table.h"
+
+// with no arguments waits for every job and succeeds, otherwise the
+// status is the wait status of the last job given
+int builtin_wait(int argc, char **argv)
+{
+    if (argc == 1) {
+        return jobs_wait_all();
+    }
+
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        jobs_reap();
+        Job_Entry *entry = jobs_find(argv[i]);
+
+        if (!entry) {
+            fprintf(stderr, "wait: %s: no such job\n", argv[i]);
+            status = W_EXITCODE(127, 0);
+            continue;
+        }
+
+        status = jobs_wait(entry);
+    }
+
+    return status;
+}
@@ -0,0 +1,134 @@
+#include "command_hash.h"
+#include "libzatar.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+typedef struct {
+  char *path;
+  int hits;
+} Command_Location;
+
+// name -> Command_Location, resolved once against $PATH and reused
+// until PATH changes or the cached file goes away
+static Z_Map *commands = NULL;
+
+static void free_command_location(Command_Location *location)
+{
+  free(location->path);
+  free(location);
+}
+
+static bool is_executable(const char *pathname)
+{
+  struct stat st;
+  return stat(pathname, &st) == 0 && S_ISREG(st.st_mode) && access(pathname, X_OK) == 0;
+}
+
+// an empty entry of PATH is the current directory, like for execvp.
+// relative is set for a command found through a relative entry.
+static char *search_path(const char *name, bool *relative)
+{
+  const char *path = getenv("PATH");
+  const char *dir = path ? path : DEFAULT_PATH;
+  Z_String candidate = {0};
+
+  for (;;) {
+    size_t len = strcspn(dir, ":");
+    z_str_clear(&candidate);
+    z_str_append_str(&candidate, len > 0 ? Z_SV(dir, len) : Z_CSTR("."));
+    z_str_append_char(&candidate, '/');
+    z_str_append_str(&candidate, Z_CSTR(name));
+
+    if (is_executable(z_str_to_cstr(&candidate))) {
+      *relative = candidate.ptr[0] != '/';
+      return candidate.ptr;
+    }
+
+    if (dir[len] == '\0') {
+      break;
+    }
+
+    dir += len + 1;
+  }
+
+  z_str_free(&candidate);
+
+  return NULL;
+}
+
+// what a relative entry of PATH finds changes with the current
+// directory, so it isn't cached. the path lives until the next lookup.
+static char *uncached_path = NULL;
+
+const char *hash_lookup_command(const char *name)
+{
+  if (!commands) {
+    commands = z_map_new((Z_Compare_Fn)strcmp);
+  }
+
+  Command_Location *location = z_map_get(commands, name);
+
+  if (!location) {
+    bool relative;
+    char *path = search_path(name, &relative);
+
+    if (!path) {
+      return NULL;
+    }
+
+    if (relative) {
+      free(uncached_path);
+      uncached_path = path;
+      return uncached_path;
+    }
+
+    location = malloc(sizeof(Command_Location));
+    location->path = path;
+    location->hits = 0;
+    z_map_put(commands, strdup(name), location, free, (Z_Free_Fn)free_command_location);
+  }
+
+  location->hits++;
+
+  return location->path;
+}
+
+void hash_forget_command(const char *name)
+{
+  if (commands) {
+    z_map_remove(commands, (void *)name, free, (Z_Free_Fn)free_command_location);
+  }
+}
+
+void hash_clear_commands()
+{
+  if (commands) {
+    z_map_free(commands, free, (Z_Free_Fn)free_command_location);
+    commands = NULL;
+  }
+}
+
+static void print_command_location(void *name, void *value, void *arg)
+{
+  (void)name;
+  (void)arg;
+  Command_Location *location = value;
+  fprintf(output_stream(), "%4d\t%s\n", location->hits, location->path);
+}
+
+void hash_print_commands()
+{
+  if (!commands || !commands->root) {
+    fprintf(output_stream(), "hash: hash table empty\n");
+    return;
+  }
+
+  fprintf(output_stream(), "hits\tcommand\n");
+  z_map_order_traverse(commands, print_command_location, NULL);
+}
@@ -0,0 +1,9 @@
+#ifndef COMMAND_HASH_H
+#define COMMAND_HASH_H
+
+const char *hash_lookup_command(const char *name);
+void hash_forget_command(const char *name);
+void hash_clear_commands();
+void hash_print_commands();
+
+#endif
@@ -0,0 +1,564 @@
+#include "compiler.h"
+#include "ast.h"
+#include "expantion.h"
+#include "libzatar.h"
+#include "token.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  int slot;
+} Declaration;
+
+// a lexical scope as seen by the resolver. a scope that may declare
+// names the compiler can't see (a 'let' with an expanded name, a
+// command substitution running in it, ...) stops resolution, since a
+// runtime declaration there could shadow anything further out.
+typedef struct {
+  Declaration *ptr;
+  int len;
+  int cap;
+  int slots_count;
+  bool is_dynamic;
+  bool has_slots;
+} Compile_Scope;
+
+typedef struct {
+  Compile_Scope *ptr;
+  int len;
+  int cap;
+} Compile_Scope_Stack;
+
+typedef struct {
+  Chunk *chunk;
+  Compile_Scope_Stack scopes;
+} Compiler;
+
+static void compile_statements(Compiler *compiler, Statement_Array statements);
+
+static int emit(Compiler *compiler, Op_Code op, int operand)
+{
+  Instruction instruction = { .op = op, .operand = operand };
+  z_da_append(&compiler->chunk->code, instruction);
+
+  return compiler->chunk->code.len - 1;
+}
+
+static void patch_jump(Compiler *compiler, int jump)
+{
+  compiler->chunk->code.ptr[jump].operand = compiler->chunk->code.len;
+}
+
+static bool is_static_word(const Argument_Plan *plan)
+{
+  return plan->is_static && plan->words.len == 1;
+}
+
+static bool is_static_command(const Argument_Plans *plans, const char *name)
+{
+  return plans->len > 0 && is_static_word(&plans->ptr[0]) && !strcmp(plans->ptr[0].words.ptr[0], name);
+}
+
+static bool may_declare_unknown_names(const Argument_Plans *plans)
+{
+  if (plans->len == 0 || !is_static_word(&plans->ptr[0])) {
+    return true;
+  }
+
+  z_da_foreach(Argument_Plan *, plan, plans) {
+    z_da_foreach(Segment *, segment, &plan->segments) {
+      if (segment->type == SEGMENT_COMMAND) {
+        return true;
+      }
+    }
+  }
+
+  return is_static_command(plans, "let") && (plans->len < 2 || !is_static_word(&plans->ptr[1]));
+}
+
+// every command of a job runs in the scope, even the right side of
+// '&&' or a pipe stage, so any of them can declare a name
+static bool is_dynamic_job(const Job *job)
+{
+  if (!job) {
+    return false;
+  }
+
+  switch (job->type) {
+    case JOB_COMMAND: {
+      Argument_Plans plans = plan_arguments(((const Job_Command *)job)->argv);
+      bool is_dynamic = may_declare_unknown_names(&plans);
+      free_argument_plans(&plans);
+
+      return is_dynamic;
+    }
+
+    case JOB_BINARY: {
+      const Job_Binary *binary = (const Job_Binary *)job;
+      return is_dynamic_job(binary->left) || is_dynamic_job(binary->right);
+    }
+
+    case JOB_UNARY:
+      return is_dynamic_job(((const Job_Unary *)job)->child);
+
+    case JOB_PIPELINE:
+      z_da_foreach(Job **, stage, &((const Job_Pipeline *)job)->stages) {
+        if (is_dynamic_job(*stage)) {
+          return true;
+        }
+      }
+
+      return false;
+  }
+
+  return true;
+}
+
+// the conditions of if and while run in the scope around them
+static bool is_dynamic_statement(const Statement *statement)
+{
+  switch (statement->type) {
+    case STATEMENT_JOB: return is_dynamic_job(((const Statement_Job *)statement)->job);
+    case STATEMENT_IF: return is_dynamic_job(((const Statement_If *)statement)->condition);
+    case STATEMENT_WHILE: return is_dynamic_job(((const Statement_While *)statement)->condition);
+    default: return false;
+  }
+}
+
+static void begin_scope(Compiler *compiler, Statement_Array statements, bool has_slots)
+{
+  Compile_Scope scope = {0};
+  scope.has_slots = has_slots;
+
+  for (int i = 0; i < statements.len && !scope.is_dynamic; i++) {
+    scope.is_dynamic = is_dynamic_statement(statements.ptr[i]);
+  }
+
+  z_da_append(&compiler->scopes, scope);
+}
+
+static int end_scope(Compiler *compiler)
+{
+  Compile_Scope scope = z_da_pop(&compiler->scopes);
+  z_da_free(&scope);
+
+  return scope.slots_count;
+}
+
+static int declare(Compiler *compiler, const char *name)
+{
+  Compile_Scope *scope = &z_da_peek(&compiler->scopes);
+
+  if (!scope->has_slots) {
+    return -1;
+  }
+
+  z_da_foreach(Declaration *, declaration, scope) {
+    if (!strcmp(declaration->name, name)) {
+      return declaration->slot;
+    }
+  }
+
+  Declaration declaration = { .name = name, .slot = scope->slots_count++ };
+  z_da_append(scope, declaration);
+
+  return declaration.slot;
+}
+
+static void resolve_segment(Compiler *compiler, Segment *segment)
+{
+  compiler->chunk->total_references++;
+
+  for (int i = compiler->scopes.len - 1; i >= 0; i--) {
+    Compile_Scope *scope = &compiler->scopes.ptr[i];
+
+    if (scope->is_dynamic || !scope->has_slots) {
+      return;
+    }
+
+    z_da_foreach(Declaration *, declaration, scope) {
+      if (!strcmp(declaration->name, segment->text)) {
+        segment->depth = compiler->scopes.len - 1 - i;
+        segment->slot = declaration->slot;
+        compiler->chunk->resolved_references++;
+        return;
+      }
+    }
+  }
+}
+
+static void resolve_plan(Compiler *compiler, Argument_Plan *plan)
+{
+  z_da_foreach(Segment *, segment, &plan->segments) {
+    if (segment->type == SEGMENT_VARIABLE || segment->type == SEGMENT_LIST || segment->type == SEGMENT_ELEMENT) {
+      resolve_segment(compiler, segment);
+    }
+  }
+}
+
+static void compile_command(Compiler *compiler, Job_Command *job)
+{
+  Compiled_Command command = {
+    .job = job,
+    .plans = plan_arguments(job->argv),
+    .declared_slot = -1,
+    .declared_name = NULL,
+  };
+
+  z_da_foreach(Argument_Plan *, plan, &command.plans) {
+    resolve_plan(compiler, plan);
+  }
+
+  command.has_static_name = command.plans.len > 0 && is_static_word(&command.plans.ptr[0]);
+
+  if (is_static_command(&command.plans, "let") && command.plans.len > 1 && is_static_word(&command.plans.ptr[1])) {
+    command.declared_name = command.plans.ptr[1].words.ptr[0];
+    command.declared_slot = declare(compiler, command.declared_name);
+  }
+
+  z_da_append(&compiler->chunk->commands, command);
+  emit(compiler, OP_COMMAND, compiler->chunk->commands.len - 1);
+}
+
+static void compile_job(Compiler *compiler, Job *job);
+
+// 'a && b' runs b only if a succeeded, 'a || b' only if it failed.
+// either way the status of the last job that ran is left behind.
+static void compile_logical(Compiler *compiler, Job_Binary *job, Op_Code skip)
+{
+  compile_job(compiler, job->left);
+  int jump = emit(compiler, skip, -1);
+  compile_job(compiler, job->right);
+  patch_jump(compiler, jump);
+}
+
+static void compile_job(Compiler *compiler, Job *job)
+{
+  if (job && job->type == JOB_COMMAND) {
+    compile_command(compiler, (Job_Command *)job);
+    return;
+  }
+
+  if (job && job->type == JOB_BINARY) {
+    Job_Binary *binary = (Job_Binary *)job;
+
+    switch (binary->operator.type) {
+      case TOKEN_AND: compile_logical(compiler, binary, OP_JUMP_IF_FAILED); return;
+      case TOKEN_OR: compile_logical(compiler, binary, OP_JUMP_IF_SUCCEEDED); return;
+      default: break;
+    }
+  }
+
+  // pipelines and background jobs keep going through the tree walker
+  z_da_append(&compiler->chunk->jobs, job);
+  emit(compiler, OP_JOB, compiler->chunk->jobs.len - 1);
+}
+
+static void compile_block(Compiler *compiler, Statement_Array statements)
+{
+  int push = emit(compiler, OP_PUSH_SCOPE, 0);
+  begin_scope(compiler, statements, true);
+  compile_statements(compiler, statements);
+  compiler->chunk->code.ptr[push].operand = end_scope(compiler);
+  emit(compiler, OP_POP_SCOPE, 0);
+}
+
+static void compile_if(Compiler *compiler, Statement_If *statement)
+{
+  compile_job(compiler, statement->condition);
+  int else_jump = emit(compiler, OP_JUMP_IF_FAILED, -1);
+  compile_block(compiler, statement->ifBranch);
+  int end_jump = emit(compiler, OP_JUMP, -1);
+  patch_jump(compiler, else_jump);
+  compile_block(compiler, statement->elseBranch);
+  patch_jump(compiler, end_jump);
+}
+
+static void compile_while(Compiler *compiler, Statement_While *statement)
+{
+  int loop_start = compiler->chunk->code.len;
+  compile_job(compiler, statement->condition);
+  int exit_jump = emit(compiler, OP_JUMP_IF_FAILED, -1);
+  compile_block(compiler, statement->body);
+  emit(compiler, OP_JUMP, loop_start);
+  patch_jump(compiler, exit_jump);
+}
+
+// the loop variable lives in its own scope around the body, always in
+// slot 0 of it. a parallel loop runs all its items in OP_FOR_PARALLEL,
+// which comes back only in the forked workers, each running the body
+// once and exiting at OP_WORKER_EXIT.
+static void compile_for(Compiler *compiler, Statement_For *statement)
+{
+  Compiled_Loop loop = {
+    .statement = statement,
+    .name = z_sv_to_cstr(statement->var_name.lexeme),
+    .string = plan_argument(statement->string),
+    .delim = plan_argument(statement->delim),
+    .from_command = statement->from_command,
+    .parallel = statement->parallel,
+  };
+
+  resolve_plan(compiler, &loop.string);
+  resolve_plan(compiler, &loop.delim);
+
+  if (loop.parallel) {
+    loop.workers = plan_argument(statement->workers);
+    resolve_plan(compiler, &loop.workers);
+  }
+
+  z_da_append(&compiler->chunk->loops, loop);
+
+  emit(compiler, OP_FOR_BEGIN, compiler->chunk->loops.len - 1);
+  begin_scope(compiler, (Statement_Array){0}, true);
+  declare(compiler, loop.name);
+
+  if (loop.parallel) {
+    int parallel = emit(compiler, OP_FOR_PARALLEL, -1);
+    compile_block(compiler, statement->body);
+    emit(compiler, OP_WORKER_EXIT, 0);
+    patch_jump(compiler, parallel);
+  } else {
+    int loop_start = emit(compiler, OP_FOR_NEXT, -1);
+    compile_block(compiler, statement->body);
+    emit(compiler, OP_JUMP, loop_start);
+    patch_jump(compiler, loop_start);
+  }
+
+  end_scope(compiler);
+  emit(compiler, OP_FOR_END, 0);
+}
+
+static void compile_function(Compiler *compiler, Statement_Function *statement)
+{
+  z_da_append(&compiler->chunk->functions, create_function(statement, compiler->chunk->program));
+  emit(compiler, OP_FUNCTION, compiler->chunk->functions.len - 1);
+}
+
+static void compile_statement(Compiler *compiler, Statement *statement)
+{
+  switch (statement->type) {
+    case STATEMENT_JOB:
+      compile_job(compiler, ((Statement_Job *)statement)->job);
+      break;
+
+    case STATEMENT_IF:
+      compile_if(compiler, (Statement_If *)statement);
+      break;
+
+    case STATEMENT_WHILE:
+      compile_while(compiler, (Statement_While *)statement);
+      break;
+
+    case STATEMENT_FOR:
+      compile_for(compiler, (Statement_For *)statement);
+      break;
+
+    case STATEMENT_FUNCTION:
+      compile_function(compiler, (Statement_Function *)statement);
+      break;
+  }
+}
+
+static void compile_statements(Compiler *compiler, Statement_Array statements)
+{
+  for (int i = 0; i < statements.len; i++) {
+    compile_statement(compiler, statements.ptr[i]);
+  }
+}
+
+// has_slots is false for a top level program: it runs in whatever scope
+// is current (the global one, or the caller's for '$(...)'), which other
+// programs use too, so only its inner blocks can be resolved
+static Chunk compile_with_scope(Statement_Array statements, Program *program, bool has_slots)
+{
+  Chunk chunk = {0};
+  chunk.program = program;
+  Compiler compiler = { .chunk = &chunk, .scopes = {0} };
+
+  begin_scope(&compiler, statements, has_slots);
+  compile_statements(&compiler, statements);
+  chunk.slots_count = end_scope(&compiler);
+  emit(&compiler, OP_RETURN, 0);
+
+  z_da_free(&compiler.scopes);
+
+  return chunk;
+}
+
+Chunk compile(Statement_Array statements, Program *program)
+{
+  return compile_with_scope(statements, program, false);
+}
+
+void free_chunk(Chunk *chunk)
+{
+  z_da_foreach(Compiled_Command *, command, &chunk->commands) {
+    free_argument_plans(&command->plans);
+  }
+
+  z_da_foreach(Compiled_Loop *, loop, &chunk->loops) {
+    free(loop->name);
+    free_argument_plan(&loop->string);
+    free_argument_plan(&loop->delim);
+
+    if (loop->parallel) {
+      free_argument_plan(&loop->workers);
+    }
+  }
+
+  z_da_free(&chunk->code);
+  z_da_free(&chunk->commands);
+  z_da_free(&chunk->jobs);
+  z_da_foreach(Flint_Function **, function, &chunk->functions) {
+    function_release(*function);
+  }
+
+  z_da_free(&chunk->loops);
+  z_da_free(&chunk->functions);
+}
+
+Flint_Function *create_function(Statement_Function *definition, Program *program)
+{
+  Flint_Function *function = malloc(sizeof(Flint_Function));
+  function->refs = 1;
+  function->program = program_retain(program);
+  function->definition = definition;
+  function->is_compiled = false;
+  function->chunk = (Chunk){0};
+
+  return function;
+}
+
+Flint_Function *function_retain(Flint_Function *function)
+{
+  function->refs++;
+
+  return function;
+}
+
+const Chunk *function_chunk(Flint_Function *function)
+{
+  if (!function->is_compiled) {
+    function->chunk = compile_with_scope(function->definition->body, function->program, true);
+    function->is_compiled = true;
+  }
+
+  return &function->chunk;
+}
+
+void function_release(Flint_Function *function)
+{
+  if (--function->refs > 0) {
+    return;
+  }
+
+  if (function->is_compiled) {
+    free_chunk(&function->chunk);
+  }
+
+  program_release(function->program);
+  free(function);
+}
+
+static const char *op_code_to_string(Op_Code op)
+{
+  switch (op) {
+#define X(op) case op: return #op;
+    OP_CODES
+#undef X
+    default: return "OP_UNKNOWN";
+  }
+}
+
+static void print_chunk_indented(const Chunk *chunk, int indent);
+
+static void print_plan(const Argument_Plan *plan)
+{
+  if (plan->is_static) {
+    z_da_foreach(char **, word, &plan->words) {
+      printf(" %s", *word);
+    }
+
+    return;
+  }
+
+  printf(" ");
+
+  z_da_foreach(Segment *, segment, &plan->segments) {
+    switch (segment->type) {
+      case SEGMENT_TEXT: printf("%s", segment->text); break;
+      case SEGMENT_HOME: printf("~"); break;
+      case SEGMENT_COMMAND: printf("$(%s)", segment->text); break;
+      case SEGMENT_ARITHMETIC: printf("$((%s))", segment->text); break;
+      case SEGMENT_LIST: printf("@%s", segment->text); break;
+      case SEGMENT_ELEMENT: printf("${%s[%s]}", segment->text, segment->index); break;
+      case SEGMENT_VARIABLE:
+        if (segment->depth >= 0) {
+          printf("${%s@%d:%d}", segment->text, segment->depth, segment->slot);
+        } else {
+          printf("${%s}", segment->text);
+        }
+        break;
+    }
+  }
+}
+
+static void print_instruction(const Chunk *chunk, int offset, int indent)
+{
+  Instruction instruction = chunk->code.ptr[offset];
+  printf("%*s%04d %-20s %4d", indent, "", offset, op_code_to_string(instruction.op), instruction.operand);
+
+  switch (instruction.op) {
+    case OP_COMMAND: {
+      z_da_foreach(Argument_Plan *, plan, &chunk->commands.ptr[instruction.operand].plans) {
+        print_plan(plan);
+      }
+
+      break;
+    }
+
+    case OP_FOR_BEGIN: {
+      const Compiled_Loop *loop = &chunk->loops.ptr[instruction.operand];
+      printf(" %s%s", loop->name, loop->from_command ? " from" : "");
+      print_plan(&loop->string);
+      print_plan(&loop->delim);
+
+      if (loop->parallel) {
+        print_plan(&loop->workers);
+      }
+
+      break;
+    }
+
+    case OP_FUNCTION: {
+      Statement_Function *function = chunk->functions.ptr[instruction.operand]->definition;
+      printf(" %.*s\n", function->name.lexeme.len, function->name.lexeme.ptr);
+      Chunk body = compile_with_scope(function->body, chunk->program, true);
+      print_chunk_indented(&body, indent + 4);
+      free_chunk(&body);
+      return;
+    }
+
+    default:
+      break;
+  }
+
+  printf("\n");
+}
+
+static void print_chunk_indented(const Chunk *chunk, int indent)
+{
+  for (int offset = 0; offset < chunk->code.len; offset++) {
+    print_instruction(chunk, offset, indent);
+  }
+
+  printf("%*s; %d of %d variable references resolved\n", indent, "", chunk->resolved_references, chunk->total_references);
+}
+
+void print_chunk(const Chunk *chunk)
+{
+  print_chunk_indented(chunk, 0);
+}
@@ -0,0 +1,140 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast.h"
+#include "builtins/builtin.h"
+#include "expantion.h"
+#include "program.h"
+#include <stdint.h>
+
+#define OP_CODES         \
+  X(OP_COMMAND)          \
+  X(OP_JOB)              \
+  X(OP_JUMP)             \
+  X(OP_JUMP_IF_FAILED)   \
+  X(OP_JUMP_IF_SUCCEEDED)\
+  X(OP_PUSH_SCOPE)       \
+  X(OP_POP_SCOPE)        \
+  X(OP_FOR_BEGIN)        \
+  X(OP_FOR_NEXT)         \
+  X(OP_FOR_END)          \
+  X(OP_FOR_PARALLEL)     \
+  X(OP_WORKER_EXIT)      \
+  X(OP_FUNCTION)         \
+  X(OP_RETURN)
+
+typedef enum {
+#define X(op) op,
+  OP_CODES
+#undef X
+} Op_Code;
+
+typedef struct {
+  uint8_t op;
+  int32_t operand;
+} Instruction;
+
+typedef struct Flint_Function Flint_Function;
+
+typedef enum {
+  COMMAND_UNRESOLVED,
+  COMMAND_FUNCTION,
+  COMMAND_BUILTIN,
+  COMMAND_EXTERNAL,
+} Command_Kind;
+
+// what a command name resolved to. it holds as long as no function was
+// defined or went away since, which the function generation tells.
+typedef struct {
+  Command_Kind kind;
+  uint64_t generation;
+  Flint_Function *function;
+  BuiltinFn builtin;
+} Command_Target;
+
+// declared_slot is the slot a 'let' with a static name binds in the
+// current scope, -1 if it declares nothing the compiler can track.
+// a command with a static name keeps its target between runs.
+typedef struct {
+  Job_Command *job;
+  Argument_Plans plans;
+  int declared_slot;
+  const char *declared_name;
+  bool has_static_name;
+  Command_Target target;
+} Compiled_Command;
+
+// string is the command to run for a loop over its output. workers
+// is only planned for a parallel loop.
+typedef struct {
+  Statement_For *statement;
+  char *name;
+  Argument_Plan string;
+  Argument_Plan delim;
+  bool from_command;
+  bool parallel;
+  Argument_Plan workers;
+} Compiled_Loop;
+
+typedef struct {
+  Instruction *ptr;
+  int len;
+  int cap;
+} Instruction_Array;
+
+typedef struct {
+  Compiled_Command *ptr;
+  int len;
+  int cap;
+} Compiled_Command_Array;
+
+typedef struct {
+  Compiled_Loop *ptr;
+  int len;
+  int cap;
+} Compiled_Loop_Array;
+
+typedef struct {
+  Flint_Function **ptr;
+  int len;
+  int cap;
+} Function_Array;
+
+// a flat instruction stream plus the tables its operands index into.
+// the tables point into the AST of the program it was compiled from,
+// which has to outlive the chunk. the chunk holds a reference to each
+// function it defines. slots_count is the number of slots the scope it
+// runs in needs, only function bodies get one.
+typedef struct {
+  Instruction_Array code;
+  Compiled_Command_Array commands;
+  Job_Array jobs;
+  Compiled_Loop_Array loops;
+  Function_Array functions;
+  Program *program;
+  int slots_count;
+  int resolved_references;
+  int total_references;
+} Chunk;
+
+// one per 'fun' statement, shared by every scope it was defined in.
+// the definition stays in the program's AST, which the function keeps
+// alive. the body is compiled the first time the function is called.
+struct Flint_Function {
+  int refs;
+  Program *program;
+  Statement_Function *definition;
+  bool is_compiled;
+  Chunk chunk;
+};
+
+Chunk compile(Statement_Array statements, Program *program);
+void free_chunk(Chunk *chunk);
+void print_chunk(const Chunk *chunk);
+
+Flint_Function *create_function(Statement_Function *definition, Program *program);
+Flint_Function *function_retain(Flint_Function *function);
+void function_release(Flint_Function *function);
+const Chunk *function_chunk(Flint_Function *function);
+
+#endif
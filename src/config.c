@@ -10,6 +10,9 @@ Flint_Config *create_default_config()
   Flint_Config *config = malloc(sizeof(Flint_Config));
   config->log_statements = false;
   config->log_tokens = false;
+  config->dump_bytecode = false;
+  config->log_lookups = false;
+  config->no_cache = false;
 
   return config;
 }
@@ -21,6 +24,12 @@ void parse_command_line_options(Flint_Config *config, int argc, char **argv)
       config->log_statements = true;
     } else if (!strcmp(argv[i], "--log-tokens")) {
       config->log_tokens = true;
+    } else if (!strcmp(argv[i], "--dump-bytecode")) {
+      config->dump_bytecode = true;
+    } else if (!strcmp(argv[i], "--log-lookups")) {
+      config->log_lookups = true;
+    } else if (!strcmp(argv[i], "--no-cache")) {
+      config->no_cache = true;
     }
   }
 }
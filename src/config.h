@@ -4,6 +4,9 @@
 typedef struct {
   bool log_tokens;
   bool log_statements;
+  bool dump_bytecode;
+  bool log_lookups;
+  bool no_cache;
 } Flint_Config;
 
 void initialize_config(int argc, char **argv);
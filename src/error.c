@@ -7,6 +7,15 @@
 #include <stdlib.h>
 #include <time.h>
 
+// counted per thread, a caller compares the count before and after its
+// own parse
+static _Thread_local int errors_count = 0;
+
+int syntax_errors_count()
+{
+  return errors_count;
+}
+
 void syntax_error(const char *fmt, ...)
 {
   va_list ap;
@@ -17,6 +26,7 @@ void syntax_error(const char *fmt, ...)
 
 void syntax_error_va(const char *fmt, va_list ap)
 {
+  errors_count++;
   fprintf(stderr, "%sYOU SUCK%s:", Z_COLOR_RED, Z_COLOR_RESET);
   vfprintf(stderr, fmt, ap);
   fprintf(stderr, "\n");
@@ -39,12 +49,13 @@ void print_str_without_tabs(FILE *out, const char *s)
 
 void syntax_error_at_token_va(const char * const *source, Token token, const char *fmt, va_list ap)
 {
+  errors_count++;
   fprintf(stderr, "%d:%d: %sYOU SUCK%s: \n", token.line, token.column, Z_COLOR_RED, Z_COLOR_RESET);
 
   if (token.type == TOKEN_EOD || token.type == TOKEN_STATEMENT_END) {
     fprintf(stderr, "at end: ");
   } else {
-    fprintf(stderr, "at '%s': ", token.lexeme);
+    fprintf(stderr, "at '%.*s': ", token.lexeme.len, token.lexeme.ptr);
   }
 
   vfprintf(stderr, fmt, ap);
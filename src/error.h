@@ -5,6 +5,7 @@
 #include "token.h"
 #include <stdarg.h>
 
+int syntax_errors_count();
 void syntax_error(const char *fmt, ...);
 void syntax_error_va(const char *fmt, va_list ap);
 void syntax_error_at_token(const char * const *source, Token token, const char *fmt, ...);
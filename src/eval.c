@@ -9,17 +9,22 @@
 #include "builtins/builtin.h"
 #include "eval.h"
 #include "expantion.h"
+#include "interpreter.h"
+#include "job_table.h"
 #include "libzatar.h"
+#include "output.h"
 #include "parser.h"
+#include "pipe_writer.h"
+#include "redirect.h"
+#include "spawn.h"
 #include "state.h"
 #include "token.h"
+#include "vm.h"
 #include "cstr.h"
 
-int evaluate_job(Job *job);
-void evaluate_block(Statement_Array statements);
-
 int safe_fork()
 {
+  fflush(stdout);
   int pid = fork();
 
   if (pid < 0) {
@@ -28,14 +33,13 @@ int safe_fork()
     exit(1);
   }
 
-  return pid;
-}
+  if (pid == 0) {
+    output_reset();
+    pipe_writer_reset();
+    jobs_reset();
+  }
 
-void safe_execvp(const char *file, char *const argv[])
-{
-  execvp(file, argv);
-  fprintf(stderr, "'%s': %s\n", file, strerror(errno));
-  exit(1);
+  return pid;
 }
 
 void set_last_status_code(int status)
@@ -61,38 +65,91 @@ void initialize_function_arguments(char **argv)
   z_str_free(&name);
 }
 
-void call_function(const Statement_Function *f, char **argv)
+void call_function(Flint_Function *function, char **argv)
 {
-  action_push_scope();
+  const Chunk *chunk = function_chunk(function);
+  action_push_scope(chunk->slots_count);
   initialize_function_arguments(argv);
-  evaluate_statements(f->body);
+  run_chunk(chunk);
   action_pop_scope();
 }
 
-int exec_command(char **argv)
+static int run_in_shell(const Command_Target *target, char **argv)
 {
-  if (argv[0] == NULL) {
+  if (target->kind == COMMAND_FUNCTION) {
+    call_function(target->function, argv);
     return 0;
   }
 
-  const char *program = argv[0];
+  return target->builtin(str_array_len(argv), argv);
+}
+
+// functions shadow builtins, which shadow programs. a target resolved
+// before is kept unless the functions changed since.
+static void resolve_command(const char *name, Command_Target *target)
+{
+  uint64_t generation = select_function_generation();
+
+  if (target->kind != COMMAND_UNRESOLVED && target->generation == generation) {
+    return;
+  }
+
+  target->generation = generation;
+  target->function = select_function(name);
+  target->builtin = target->function ? NULL : get_builtin(name);
+
+  if (target->function) {
+    target->kind = COMMAND_FUNCTION;
+  } else if (target->builtin) {
+    target->kind = COMMAND_BUILTIN;
+  } else {
+    target->kind = COMMAND_EXTERNAL;
+  }
+}
+
+// moves are the command's redirections, NULL if it has none
+int exec_command(char **argv, const Fd_Moves *moves)
+{
+  Command_Target target = {0};
+  return exec_command_target(argv, moves, &target);
+}
 
-  if (select_function(program)) {
-    call_function(select_function(program), argv);
+// target caches what argv[0] resolves to, so it has to be the same
+// name on every call
+int exec_command_target(char **argv, const Fd_Moves *moves, Command_Target *target)
+{
+  if (argv[0] == NULL) {
     return 0;
   }
 
-  if (get_builtin(program)) {
-    return get_builtin(program)(str_array_len(argv), argv);
+  // background jobs that finished are collected between commands,
+  // so a script that never waits doesn't pile up zombies
+  jobs_reap();
+
+  bool redirected = moves && moves->len > 0;
+  resolve_command(argv[0], target);
+
+  if (target->kind != COMMAND_EXTERNAL) {
+    if (!redirected) {
+      return run_in_shell(target, argv);
+    }
+
+    Saved_Fds saved;
+
+    if (!redirects_enter(moves, &saved)) {
+      return 1;
+    }
+
+    int status = run_in_shell(target, argv);
+    redirects_leave(&saved);
+
+    return status;
   }
 
-  int status = 0;
-  int pid = safe_fork();
+  int status;
 
-  if (pid == 0) {
-    safe_execvp(program, argv);
-  } else {
-    waitpid(pid, &status, 0);
+  if (!redirected || !redirects_cat(argv, moves, &status)) {
+    status = spawn_and_wait(argv, moves);
   }
 
   set_last_status_code(status);
@@ -102,51 +159,154 @@ int exec_command(char **argv)
 
 int evaluate_command(Job_Command *job)
 {
-  char **argv = expand_argv(job->argv);
-  int status = exec_command(argv);
-  str_free_array(argv);
+  Arena *arena = interpreter_arena();
+  Arena_Mark mark = arena_mark(arena);
+  char **argv = expand_argv(job->argv, arena);
+  Fd_Moves moves = {0};
+  int status = redirects_open(&job->redirects, arena, &moves) ? exec_command(argv, &moves) : 1;
+  redirects_close(&moves);
+  arena_release(arena, mark);
 
   return status;
 }
 
-void close_pipe(int fd[2])
+static bool is_external_command(char **argv)
 {
-  close(fd[0]);
-  close(fd[1]);
+  return argv[0] && !select_function(argv[0]) && !get_builtin(argv[0]);
 }
 
-int evaluate_pipe(Job_Binary *job)
+// the forked interpreter only keeps its own stdin / stdout. it also
+// drops the read end of the pipe it writes to, otherwise it would
+// block instead of getting SIGPIPE when the next stage exits early.
+static int fork_pipe_stage(Job *job, char **argv, const Fd_Moves *moves, int in_fd, int out_fd, int next_fd)
 {
-  Job_Command *command = (Job_Command *)job->left;
-  Job *right = job->right;
+  int pid = safe_fork();
+
+  if (pid == 0) {
+    if (in_fd != STDIN_FILENO) {
+      dup2(in_fd, STDIN_FILENO);
+      close(in_fd);
+    }
 
-  int fd[2];
-  pipe(fd);
+    if (out_fd != STDOUT_FILENO) {
+      dup2(out_fd, STDOUT_FILENO);
+      close(out_fd);
+    }
 
-  int pid1 = safe_fork();
+    if (next_fd >= 0) {
+      close(next_fd);
+    }
 
-  if (pid1 == 0) {
-    dup2(fd[1], STDOUT_FILENO);
-    close_pipe(fd);
-    exit(evaluate_command(command));
+    exit(child_exit_code(argv ? exec_command(argv, moves) : evaluate_job(job)));
   }
 
-  int pid2 = safe_fork();
+  return pid;
+}
+
+typedef struct {
+  int pid;
+  Pipe_Writer *writer;
+} Pipeline_Stage;
+
+// external commands are spawned straight onto the pipe. pure builtins
+// run in the shell with a thread writing their output, anything else
+// (other builtins, functions) needs a copy of the interpreter.
+static Pipeline_Stage start_pipe_stage(Job *job, int in_fd, int out_fd, int next_fd)
+{
+  Pipeline_Stage stage = { .pid = -1 };
+
+  if (job->type != JOB_COMMAND) {
+    stage.pid = fork_pipe_stage(job, NULL, NULL, in_fd, out_fd, next_fd);
+    return stage;
+  }
 
-  if (pid2 == 0) {
-    dup2(fd[0], STDIN_FILENO);
-    close_pipe(fd);
-    exit(evaluate_job(right));
+  Job_Command *command = (Job_Command *)job;
+  Arena *arena = interpreter_arena();
+  Arena_Mark mark = arena_mark(arena);
+  char **argv = expand_argv(command->argv, arena);
+  Fd_Moves moves = {0};
+
+  if (!redirects_open(&command->redirects, arena, &moves)) {
+    stage.pid = -1;
+  } else if (is_external_command(argv)) {
+    stage.pid = spawn_process(argv, in_fd, out_fd, &moves);
+  } else if (argv[0] && moves.len == 0 && !select_function(argv[0]) && get_pure_builtin(argv[0])) {
+    stage.writer = pipe_writer_start(get_pure_builtin(argv[0]), argv, out_fd);
+  } else {
+    stage.pid = fork_pipe_stage(job, argv, &moves, in_fd, out_fd, next_fd);
   }
 
-  close_pipe(fd);
+  redirects_close(&moves);
+  arena_release(arena, mark);
 
-  int status1;
-  int status2;
-  waitpid(pid1, &status1, 0);
-  waitpid(pid2, &status2, 0);
+  return stage;
+}
+
+static int wait_pipe_stage(Pipeline_Stage stage)
+{
+  return stage.writer ? pipe_writer_wait(stage.writer) : wait_process(stage.pid);
+}
+
+static void set_pipe_status(const int *statuses, int count)
+{
+  Z_String s = {0};
+
+  for (int i = 0; i < count; i++) {
+    z_str_append_format(&s, i ? " %d" : "%d", exit_code(statuses[i]));
+  }
 
-  return status2;
+  action_create_global_variable("PIPESTATUS", z_str_to_cstr(&s));
+  z_str_free(&s);
+}
+
+// every stage is a direct child of this process. a pipe is opened
+// right before the stage that writes to it, and the parent closes its
+// copies as soon as both sides have been started, so at most one pipe
+// is open here at a time. the status of each stage ends up in
+// PIPESTATUS, the pipeline itself returns the status of the last one.
+int evaluate_pipeline(Job_Pipeline *job)
+{
+  Arena *arena = interpreter_arena();
+  Arena_Mark mark = arena_mark(arena);
+  int count = job->stages.len;
+  Pipeline_Stage *stages = arena_alloc(arena, count * sizeof(Pipeline_Stage));
+  int *statuses = arena_alloc(arena, count * sizeof(int));
+
+  int collect_fd;
+  int out_fd = output_child_fd(&collect_fd);
+  int in_fd = STDIN_FILENO;
+
+  for (int i = 0; i < count; i++) {
+    int fd[2] = { -1, out_fd };
+
+    if (i < count - 1) {
+      open_pipe(fd);
+    }
+
+    stages[i] = start_pipe_stage(job->stages.ptr[i], in_fd, fd[1], fd[0]);
+
+    if (in_fd != STDIN_FILENO) {
+      close(in_fd);
+    }
+
+    if (fd[1] != out_fd) {
+      close(fd[1]);
+    }
+
+    in_fd = fd[0];
+  }
+
+  output_collect(collect_fd, out_fd);
+
+  for (int i = 0; i < count; i++) {
+    statuses[i] = wait_pipe_stage(stages[i]);
+  }
+
+  int status = statuses[count - 1];
+  set_pipe_status(statuses, count);
+  arena_release(arena, mark);
+
+  return status;
 }
 
 int evaluate_and(Job_Binary *job)
@@ -161,20 +321,21 @@ int evaluate_or(Job_Binary *job)
   return status ? evaluate_job(job->right) : status;
 }
 
+// the job gets its own process group, set on both sides of the fork
+// so neither can act on it before it exists
 int evaluate_ampersand(Job_Unary *job)
 {
-  if (safe_fork() == 0) {
-    int status = evaluate_job(job->child);
-
-    if (status != 0) {
-      fprintf(stderr, "exit with status %d\n", status);
-    } else {
-      printf("done\n");
-    }
+  int pid = safe_fork();
 
-    exit(status);
+  if (pid == 0) {
+    setpgid(0, 0);
+    exit(child_exit_code(evaluate_job(job->child)));
   }
 
+  setpgid(pid, pid);
+  jobs_reap();
+  jobs_add(pid, job->child);
+
   return 0;
 }
 
@@ -193,7 +354,6 @@ int evaluate_binary(Job_Binary *job)
   switch (job->operator.type) {
     case TOKEN_AND: return evaluate_and(job);
     case TOKEN_OR: return evaluate_or(job);
-    case TOKEN_PIPE: return evaluate_pipe(job);
     default:
       assert(0 && "Unknown operator\n");
       return 0; // unreachable
@@ -210,100 +370,8 @@ int evaluate_job(Job *job)
     case JOB_COMMAND: return evaluate_command((Job_Command *)job);
     case JOB_UNARY: return evaluate_unary((Job_Unary *)job);
     case JOB_BINARY: return evaluate_binary((Job_Binary *)job);
+    case JOB_PIPELINE: return evaluate_pipeline((Job_Pipeline *)job);
   }
 
   return 0;
 }
-
-void evaluate_block(Statement_Array statements)
-{
-  action_push_scope();
-  evaluate_statements(statements);
-  action_pop_scope();
-}
-
-void evaluate_if(Statement_If *statement)
-{
-  if (!evaluate_job(statement->condition)) {
-    evaluate_block(statement->ifBranch);
-  } else {
-    evaluate_block(statement->elseBranch);
-  }
-}
-
-void evaluate_while(Statement_While *statement)
-{
-  while (!evaluate_job(statement->condition)) {
-    evaluate_block(statement->body);
-  }
-}
-
-void evaluate_for(Statement_For *statement)
-{
-  action_push_scope();
-
-  String_Array delim = {0};
-  String_Array string = {0};
-  expand_token(statement->delim, &delim);
-  expand_token(statement->string, &string);
-
-  Z_String name = z_str_new_from(Z_CSTR(statement->var_name.lexeme));
-  Z_String value = {0};
-
-  action_create_variable(z_str_to_cstr(&name), "");
-
-  z_sv_split_cset_foreach(Z_CSTR(string.ptr[0]), Z_CSTR(delim.ptr[0]), tok) {
-    value.len = 0;
-    z_str_append_str(&value, tok);
-    action_mutate_variable(z_str_to_cstr(&name), z_str_to_cstr(&value));
-    evaluate_block(statement->body);
-  }
-
-  z_str_free(&value);
-  z_str_free(&name);
-  z_da_append(&delim, NULL);
-  z_da_append(&string, NULL);
-  str_free_array(delim.ptr);
-  str_free_array(string.ptr);
-
-  action_pop_scope();
-}
-
-void evaluate_function(Statement_Function *function)
-{
-  action_create_fuction(function->name.lexeme, function);
-}
-
-int evaluate_statement(Statement *statement)
-{
-  switch (statement->type) {
-  case STATEMENT_JOB:
-    return evaluate_job(((Statement_Job *)statement)->job);
-
-  case STATEMENT_IF:
-    evaluate_if(((Statement_If *)statement));
-    return 0;
-
-  case STATEMENT_WHILE:
-    evaluate_while((Statement_While *)statement);
-    return 0;
-
-  case STATEMENT_FOR:
-    evaluate_for((Statement_For *)statement);
-    return 0;
-
-  case STATEMENT_FUNCTION:
-    evaluate_function((Statement_Function *)statement);
-    return 0;
-
-  default:
-    return 0;
-  }
-}
-
-void evaluate_statements(Statement_Array statements)
-{
-  for (int i = 0; i < statements.len; i++) {
-    evaluate_statement(statements.ptr[i]);
-  }
-}
@@ -1,9 +1,13 @@
 #ifndef EVAL_H
 #define EVAL_H
 
+#include "compiler.h"
 #include "parser.h"
+#include "redirect.h"
 
-void evaluate_statements(Statement_Array statements);
-int exec_command(char **argv);
+int safe_fork();
+int evaluate_job(Job *job);
+int exec_command(char **argv, const Fd_Moves *moves);
+int exec_command_target(char **argv, const Fd_Moves *moves, Command_Target *target);
 
 #endif
@@ -1,4 +1,6 @@
 #include "expantion.h"
+#include "arena.h"
+#include "arithmetic.h"
 #include "builtins/builtin.h"
 #include "eval.h"
 #include "interpreter.h"
@@ -12,7 +14,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void command_substitution(Z_Scanner *scanner, Z_String *output);
 static void scanner_advance_single_quoted_string(Z_Scanner *scanner);
 static void scanner_advance_double_quoted_string(Z_Scanner *scanner);
 static void scanner_advance_command_substitution(Z_Scanner *scanner);
@@ -62,16 +63,56 @@ static void scanner_advance_single_quoted_string(Z_Scanner *scanner)
   }
 }
 
-static void command_substitution(Z_Scanner *scanner, Z_String *output)
+static void append_segment(Segment_Array *segments, Segment_Type type, Z_String_View text)
+{
+  Segment segment = {
+    .type = type,
+    .text = z_sv_to_cstr(text),
+    .index = NULL,
+    .depth = -1,
+    .slot = -1,
+  };
+
+  z_da_append(segments, segment);
+}
+
+static void flush_text(Segment_Array *segments, Z_String *text)
+{
+  if (text->len > 0) {
+    append_segment(segments, SEGMENT_TEXT, Z_STR(*text));
+    text->len = 0;
+  }
+}
+
+static void command_substitution(Z_Scanner *scanner, Segment_Array *segments)
 {
   z_scanner_reset_mark(scanner);
   scanner_advance_command_substitution(scanner);
   Z_String_View command = z_scanner_capture(*scanner);
   command.len--;
-  interpret_to(command, output);
+  append_segment(segments, SEGMENT_COMMAND, command);
+}
+
+// '$((' up to the matching '))', parentheses inside may nest
+static void arithmetic(Z_Scanner *scanner, Segment_Array *segments)
+{
+  z_scanner_reset_mark(scanner);
+  int depth = 0;
+
+  while (!z_scanner_is_at_end(*scanner)) {
+    if (depth == 0 && z_scanner_check_string(*scanner, Z_CSTR("))"))) {
+      break;
+    }
+
+    char c = z_scanner_advance(scanner);
+    depth += (c == '(') - (c == ')');
+  }
+
+  append_segment(segments, SEGMENT_ARITHMETIC, z_scanner_capture(*scanner));
+  z_scanner_match_string(scanner, Z_CSTR("))"));
 }
 
-void braced_variable(Z_Scanner *scanner, Z_String *output)
+void braced_variable(Z_Scanner *scanner, Segment_Array *segments, Z_String *text)
 {
   z_scanner_reset_mark(scanner);
 
@@ -80,13 +121,21 @@ void braced_variable(Z_Scanner *scanner, Z_String *output)
   }
 
   if (z_scanner_is_at_end(*scanner)) {
-    z_str_append_str(output, z_scanner_capture(*scanner));
+    z_str_append_str(text, z_scanner_capture(*scanner));
     return;
   }
 
-  char *var_name = z_sv_to_cstr(z_scanner_capture(*scanner));
-  z_str_append_format(output, "%s", select_variable(var_name));
-  free(var_name);
+  flush_text(segments, text);
+  Z_String_View name = z_scanner_capture(*scanner);
+  const char *bracket = memchr(name.ptr, '[', name.len);
+
+  if (bracket && name.ptr[name.len - 1] == ']') {
+    Z_String_View index = Z_SV(bracket + 1, name.ptr + name.len - 1 - (bracket + 1));
+    append_segment(segments, SEGMENT_ELEMENT, Z_SV(name.ptr, bracket - name.ptr));
+    z_da_peek(segments).index = z_sv_to_cstr(index);
+  } else {
+    append_segment(segments, SEGMENT_VARIABLE, name);
+  }
 
   z_scanner_advance(scanner); // eat the '}'
 }
@@ -96,7 +145,7 @@ bool is_variable_char(char c)
   return isdigit(c) || isalpha(c) || strchr("_?@", c);
 }
 
-void variable(Z_Scanner *scanner, Z_String *output)
+void variable(Z_Scanner *scanner, Segment_Array *segments)
 {
   z_scanner_reset_mark(scanner);
 
@@ -104,9 +153,7 @@ void variable(Z_Scanner *scanner, Z_String *output)
     z_scanner_advance(scanner);
   }
 
-  char *var_name = z_sv_to_cstr(z_scanner_capture(*scanner));
-  z_str_append_format(output, "%s", select_variable(var_name));
-  free(var_name);
+  append_segment(segments, SEGMENT_VARIABLE, z_scanner_capture(*scanner));
 }
 
 char escaped_char(char c)
@@ -119,111 +166,466 @@ char escaped_char(char c)
   }
 }
 
+// appends the raw character, z_str_append_char goes through printf
 void escape_sequence(Z_Scanner *scanner, Z_String *output)
 {
   char c = z_scanner_advance(scanner);
 
   if (c == '\\' && !z_scanner_is_at_end(*scanner)) {
-    z_str_append_char(output, escaped_char(z_scanner_advance(scanner)));
+    z_da_append(output, escaped_char(z_scanner_advance(scanner)));
   } else {
-    z_str_append_char(output, c);
+    z_da_append(output, c);
   }
 }
 
-void expand_dqouted_string(Token token, String_Array *output)
+static void split_dquoted_string(Token token, Segment_Array *segments)
 {
-  Z_Scanner scanner = z_scanner_new(Z_CSTR(token.lexeme));
-  Z_String exapnded = {0};
+  Z_Scanner scanner = z_scanner_new(token.lexeme);
+  Z_String text = {0};
 
   if (z_scanner_match(&scanner, '~')) {
-    z_str_append_str(&exapnded, z_get_home_path());
+    append_segment(segments, SEGMENT_HOME, Z_EMPTY_SV());
   }
 
   while (!z_scanner_is_at_end(scanner)) {
     if (z_scanner_match(&scanner, '$')) {
-      if (z_scanner_match(&scanner, '(')) {
-        command_substitution(&scanner, &exapnded);
+      if (z_scanner_match_string(&scanner, Z_CSTR("(("))) {
+        flush_text(segments, &text);
+        arithmetic(&scanner, segments);
+      } else if (z_scanner_match(&scanner, '(')) {
+        flush_text(segments, &text);
+        command_substitution(&scanner, segments);
       } else if (z_scanner_match(&scanner, '{')) {
-        braced_variable(&scanner, &exapnded);
+        braced_variable(&scanner, segments, &text);
       } else {
-        variable(&scanner, &exapnded);
+        flush_text(segments, &text);
+        variable(&scanner, segments);
       }
     } else {
-      escape_sequence(&scanner, &exapnded);
+      escape_sequence(&scanner, &text);
     }
   }
 
-  z_da_append(output, (char *)z_str_to_cstr(&exapnded));
+  flush_text(segments, &text);
+  z_str_free(&text);
 }
 
-void expand_word(Token token, String_Array *output)
+static void split_sqouted_string(Token token, Segment_Array *segments)
 {
-  String_Array tmp = {0};
-  expand_dqouted_string(token, &tmp);
+  Z_Scanner scanner = z_scanner_new(token.lexeme);
+  Z_String text = {0};
 
-  z_sv_split_cset_foreach(Z_CSTR(tmp.ptr[0]), Z_CSTR(" \n"), word) {
-    z_da_append(output, strndup(word.ptr, word.len));
+  while (!z_scanner_is_at_end(scanner)) {
+    escape_sequence(&scanner, &text);
   }
 
-  free(tmp.ptr[0]);
-  free(tmp.ptr);
+  flush_text(segments, &text);
+  z_str_free(&text);
 }
 
-void expand_sqouted_string(Token token, String_Array *output)
+// the name of the list a word like '@name' refers to, empty for any
+// other token
+Z_String_View list_reference(Token token)
 {
-  Z_Scanner scanner = z_scanner_new(Z_CSTR(token.lexeme));
-  Z_String expanded = {0};
+  Z_String_View lexeme = token.lexeme;
 
-  while (!z_scanner_is_at_end(scanner)) {
-    escape_sequence(&scanner, &expanded);
+  if (token.type != TOKEN_WORD || lexeme.len < 2 || lexeme.ptr[0] != '@' || isdigit(lexeme.ptr[1])) {
+    return Z_EMPTY_SV();
+  }
+
+  for (int i = 1; i < lexeme.len; i++) {
+    if (!isalnum(lexeme.ptr[i]) && lexeme.ptr[i] != '_') {
+      return Z_EMPTY_SV();
+    }
+  }
+
+  return Z_SV(lexeme.ptr + 1, lexeme.len - 1);
+}
+
+static void split_segments(Token token, Segment_Array *segments)
+{
+  Z_String_View list = list_reference(token);
+
+  if (list.len > 0) {
+    append_segment(segments, SEGMENT_LIST, list);
+  } else if (token.type == TOKEN_WORD || token.type == TOKEN_DQUOTED_STRING) {
+    split_dquoted_string(token, segments);
+  } else {
+    split_sqouted_string(token, segments);
+  }
+}
+
+static const char *segment_variable_value(const Segment *segment)
+{
+  if (segment->depth >= 0) {
+    return select_resolved_variable(segment->depth, segment->slot, segment->text);
+  }
+
+  return select_variable(segment->text);
+}
+
+static Value *segment_value(const Segment *segment)
+{
+  if (segment->depth >= 0) {
+    return select_resolved_value(segment->depth, segment->slot, segment->text);
+  }
+
+  return select_variable_value(segment->text);
+}
+
+// a NUL terminated string growing at the top of an arena
+typedef struct {
+  char *ptr;
+  int len;
+  int cap;
+} Arena_String;
+
+static void arena_string_append(Arena *arena, Arena_String *string, Z_String_View text)
+{
+  if (string->len + text.len + 1 > string->cap) {
+    int new_cap = z_max(z_max(string->cap * 2, string->len + text.len + 1), 64);
+    string->ptr = arena_grow(arena, string->ptr, string->cap, new_cap);
+    string->cap = new_cap;
+  }
+
+  memcpy(string->ptr + string->len, text.ptr, text.len);
+  string->len += text.len;
+  string->ptr[string->len] = '\0';
+}
+
+// an index counts from the end of the list when it's negative, an
+// empty one is the fallback
+static bool list_index(const char *expression, int len, int items, int fallback, int *index)
+{
+  char *text = strndup(expression, len);
+  Number number = { .integer = fallback };
+  bool ok = text[strspn(text, " ")] == '\0' || arithmetic_evaluate(text, &number);
+
+  if (ok && number.is_float) {
+    fprintf(stderr, "'%s': index is not an integer\n", text);
+    ok = false;
+  }
+
+  free(text);
+  *index = number.integer < 0 ? number.integer + items : number.integer;
+
+  return ok;
+}
+
+// '${name[index]}' expands to one item, '${name[first:last]}' to the
+// items from first up to last separated by spaces. indexes out of the
+// list expand to nothing.
+static void expand_element(const Segment *segment, Arena *arena, Arena_String *output)
+{
+  Value *value = segment_value(segment);
+
+  if (!value) {
+    return;
+  }
+
+  int count;
+  Value *items = value_items(value, &count);
+  const char *colon = strchr(segment->index, ':');
+  int first;
+  int last;
+
+  if (!colon) {
+    if (list_index(segment->index, strlen(segment->index), count, count, &first) && first >= 0 && first < count) {
+      arena_string_append(arena, output, Z_CSTR(value_text(&items[first])));
+    }
+
+    return;
+  }
+
+  if (!list_index(segment->index, colon - segment->index, count, 0, &first)
+      || !list_index(colon + 1, strlen(colon + 1), count, count, &last)) {
+    return;
   }
 
-  z_da_append(output, (char *)z_str_to_cstr(&expanded));
+  first = z_max(first, 0);
+  last = z_min(last, count);
+
+  for (int i = first; i < last; i++) {
+    if (i > first) {
+      arena_string_append(arena, output, Z_CSTR(" "));
+    }
+
+    arena_string_append(arena, output, Z_CSTR(value_text(&items[i])));
+  }
 }
 
-void expand_token(Token token, String_Array *out)
+static void expand_segments(const Segment_Array *segments, Arena *arena, Arena_String *output)
 {
-  switch (token.type) {
-  case TOKEN_WORD:
-    expand_word(token, out);
-    break;
+  arena_string_append(arena, output, Z_EMPTY_SV());
+
+  z_da_foreach(Segment *, segment, segments) {
+    switch (segment->type) {
+      case SEGMENT_TEXT:
+        arena_string_append(arena, output, Z_CSTR(segment->text));
+        break;
+
+      case SEGMENT_HOME:
+        arena_string_append(arena, output, z_get_home_path());
+        break;
+
+      case SEGMENT_VARIABLE: {
+        const char *value = segment_variable_value(segment);
+        arena_string_append(arena, output, Z_CSTR(value));
+        break;
+      }
+
+      case SEGMENT_COMMAND: {
+        Z_String captured = {0};
+        interpret_to(Z_CSTR(segment->text), &captured);
+        arena_string_append(arena, output, Z_STR(captured));
+        z_str_free(&captured);
+        break;
+      }
+
+      case SEGMENT_ELEMENT:
+        expand_element(segment, arena, output);
+        break;
+
+      // only when there's no such variable, the word stays as it was
+      case SEGMENT_LIST:
+        arena_string_append(arena, output, Z_CSTR("@"));
+        arena_string_append(arena, output, Z_CSTR(segment->text));
+        break;
+
+      case SEGMENT_ARITHMETIC: {
+        Number result;
 
-  case TOKEN_DQUOTED_STRING:
-    expand_dqouted_string(token, out);
-    break;
+        if (arithmetic_evaluate(segment->text, &result)) {
+          char buffer[NUMBER_BUFFER_SIZE];
+          number_format(result, buffer);
+          arena_string_append(arena, output, Z_CSTR(buffer));
+        }
 
-  case TOKEN_SQUOTED_STRING:
-  default:
-    expand_sqouted_string(token, out);
-    break;
+        break;
+      }
+    }
   }
 }
 
-char **expand_argv(Token_Array argv)
+static bool is_word_separator(char c)
+{
+  return c == ' ' || c == '\n';
+}
+
+// words are split on whitespace after expansion, quoted strings
+// always expand to exactly one argument. the words are cut out of the
+// expanded string in place.
+static void expand_with_segments(Token_Type type, const Segment_Array *segments, Arena *arena, String_Array *out)
+{
+  Value *list = segments->len == 1 && segments->ptr[0].type == SEGMENT_LIST ? segment_value(&segments->ptr[0]) : NULL;
+
+  if (list) {
+    int count;
+    Value *items = value_items(list, &count);
+
+    for (int i = 0; i < count; i++) {
+      const char *text = value_text(&items[i]);
+      arena_da_append(arena, out, arena_strndup(arena, text, items[i].len));
+    }
+
+    return;
+  }
+
+  Arena_String expanded = {0};
+  expand_segments(segments, arena, &expanded);
+
+  if (type != TOKEN_WORD) {
+    arena_da_append(arena, out, expanded.ptr);
+    return;
+  }
+
+  char *end = expanded.ptr + expanded.len;
+
+  for (char *p = expanded.ptr; p < end;) {
+    while (p < end && is_word_separator(*p)) {
+      *p++ = '\0';
+    }
+
+    if (p == end) {
+      break;
+    }
+
+    arena_da_append(arena, out, p);
+
+    while (p < end && !is_word_separator(*p)) {
+      p++;
+    }
+  }
+}
+
+static void free_segments(Segment_Array *segments)
+{
+  z_da_foreach(Segment *, segment, segments) {
+    free(segment->text);
+    free(segment->index);
+  }
+
+  z_da_free(segments);
+}
+
+void expand_token(Token token, Arena *arena, String_Array *out)
+{
+  Segment_Array segments = {0};
+  split_segments(token, &segments);
+  expand_with_segments(token.type, &segments, arena, out);
+  free_segments(&segments);
+}
+
+char **expand_argv(Token_Array argv, Arena *arena)
 {
   String_Array expanded = {0};
 
   for (int i = 0; i < argv.len; i++) {
     Token arg = argv.ptr[i];
-    expand_token(arg, &expanded);
+    expand_token(arg, arena, &expanded);
   }
 
-  z_da_null_terminate(&expanded);
+  arena_da_append(arena, &expanded, NULL);
 
   return expanded.ptr;
 }
 
-void expand_alias(Token key, Token_Array *output)
+static bool is_static_segments(const Segment_Array *segments)
 {
-  const char *value = select_alias(key.lexeme);
+  z_da_foreach(Segment *, segment, segments) {
+    if (segment->type != SEGMENT_TEXT) {
+      return false;
+    }
+  }
 
-  if (!value) {
-    z_da_append(output, key);
-  } else {
-    Token_Array tmp = lexer_get_tokens(Z_CSTR(value));
-    z_da_append_da(output, &tmp);
-    output->len--; // remove EOF token
-    free(tmp.ptr);
+  return true;
+}
+
+static void split_static_words(Token_Type type, const Segment_Array *segments, String_Array *words)
+{
+  Z_String text = {0};
+
+  z_da_foreach(Segment *, segment, segments) {
+    z_str_append_str(&text, Z_CSTR(segment->text));
+  }
+
+  if (type != TOKEN_WORD) {
+    z_da_append(words, z_str_to_cstr(&text));
+    return;
+  }
+
+  z_sv_split_cset_foreach(Z_STR(text), Z_CSTR(" \n"), word) {
+    z_da_append(words, strndup(word.ptr, word.len));
+  }
+
+  z_str_free(&text);
+}
+
+// a token made only of text expands to the same words every time, so
+// it is expanded once when it is planned. anything else keeps its
+// segments, which the compiler may bind to scope slots.
+Argument_Plan plan_argument(Token token)
+{
+  Argument_Plan plan = {
+    .type = token.type,
+    .is_static = false,
+    .words = {0},
+    .segments = {0},
+  };
+
+  split_segments(token, &plan.segments);
+  plan.is_static = is_static_segments(&plan.segments);
+
+  if (plan.is_static) {
+    split_static_words(plan.type, &plan.segments, &plan.words);
+  }
+
+  return plan;
+}
+
+// static words are handed out as they are, the expanded argv only
+// borrows them from the plan
+void expand_planned_argument(const Argument_Plan *plan, Arena *arena, String_Array *out)
+{
+  if (!plan->is_static) {
+    expand_with_segments(plan->type, &plan->segments, arena, out);
+    return;
+  }
+
+  z_da_foreach(char **, word, &plan->words) {
+    arena_da_append(arena, out, *word);
+  }
+}
+
+// the variable a plan for '@name' refers to, NULL for anything else
+Value *planned_list(const Argument_Plan *plan)
+{
+  if (plan->segments.len != 1 || plan->segments.ptr[0].type != SEGMENT_LIST) {
+    return NULL;
+  }
+
+  return segment_value(&plan->segments.ptr[0]);
+}
+
+void free_argument_plan(Argument_Plan *plan)
+{
+  z_da_foreach(char **, word, &plan->words) {
+    free(*word);
+  }
+
+  z_da_free(&plan->words);
+  free_segments(&plan->segments);
+}
+
+Argument_Plans plan_arguments(Token_Array argv)
+{
+  Argument_Plans plans = {0};
+
+  z_da_foreach(Token *, arg, &argv) {
+    z_da_append(&plans, plan_argument(*arg));
+  }
+
+  return plans;
+}
+
+char **expand_planned_argv(const Argument_Plans *plans, Arena *arena)
+{
+  String_Array expanded = {0};
+
+  z_da_foreach(Argument_Plan *, plan, plans) {
+    expand_planned_argument(plan, arena, &expanded);
+  }
+
+  arena_da_append(arena, &expanded, NULL);
+
+  return expanded.ptr;
+}
+
+void free_argument_plans(Argument_Plans *plans)
+{
+  z_da_foreach(Argument_Plan *, plan, plans) {
+    free_argument_plan(plan);
+  }
+
+  z_da_free(plans);
+}
+
+// the alias tokens point into the alias' own source, which the
+// program's source holds on to
+void expand_alias(Token key, Token_Array *output, Source *source, Arena *arena)
+{
+  Source *alias = select_alias(key.lexeme);
+
+  if (!alias) {
+    arena_da_append(arena, output, key);
+    return;
+  }
+
+  source_depend(source, alias);
+  Token_Array tmp = lexer_get_tokens(source_view(alias), arena);
+
+  for (int i = 0; i < tmp.len - 1; i++) { // skip the EOF token
+    arena_da_append(arena, output, tmp.ptr[i]);
   }
 }
 
@@ -232,7 +634,7 @@ static bool is_string(Token_Type type)
   return type == TOKEN_WORD || type == TOKEN_DQUOTED_STRING || type == TOKEN_SQUOTED_STRING;
 }
 
-void expand_aliases(Token_Array *tokens)
+void expand_aliases(Token_Array *tokens, Source *source, Arena *arena)
 {
   Token_Array tmp = {0};
   bool is_command_start = true;
@@ -242,16 +644,14 @@ void expand_aliases(Token_Array *tokens)
 
     if (!is_string(token.type) && token.type != TOKEN_FUN) {
       is_command_start = true;
-      z_da_append(&tmp, token);
+      arena_da_append(arena, &tmp, token);
     } else if (!is_command_start) {
-      z_da_append(&tmp, token);
+      arena_da_append(arena, &tmp, token);
     } else {
-      expand_alias(token, &tmp);
+      expand_alias(token, &tmp, source, arena);
       is_command_start = false;
     }
   }
 
-  z_da_clear(tokens);
-  z_da_append_da(tokens, &tmp);
-  z_da_free(&tmp);
+  *tokens = tmp;
 }
@@ -1,7 +1,10 @@
 #ifndef EXPANTION_H
 #define EXPANTION_H
 
-#include "eval.h"
+#include "arena.h"
+#include "source.h"
+#include "token.h"
+#include "value.h"
 
 typedef struct {
   char **ptr;
@@ -9,8 +12,63 @@ typedef struct {
   int cap;
 } String_Array;
 
-void expand_token(Token token, String_Array *out);
-char **expand_argv(Token_Array argv);
-void expand_aliases(Token_Array *tokens);
+typedef enum {
+  SEGMENT_TEXT,
+  SEGMENT_HOME,
+  SEGMENT_VARIABLE,
+  SEGMENT_COMMAND,
+  SEGMENT_ARITHMETIC,
+  SEGMENT_LIST,
+  SEGMENT_ELEMENT,
+} Segment_Type;
+
+// one piece of a token: literal text, '~', a variable reference, a
+// command substitution or an arithmetic expansion. a word that is only
+// '@name' is a list reference, whose items become one argument each
+// ('@name' stays as it is if there's no such variable).
+// '${name[index]}' is an item of a list, or a 'first:last' slice of
+// it, with index holding what's between the brackets. variable
+// references the compiler could resolve carry the (depth, slot) of
+// their declaration, -1 otherwise.
+typedef struct {
+  Segment_Type type;
+  char *text;
+  char *index;
+  int depth;
+  int slot;
+} Segment;
+
+typedef struct {
+  Segment *ptr;
+  int len;
+  int cap;
+} Segment_Array;
+
+typedef struct {
+  Token_Type type;
+  bool is_static;
+  String_Array words;
+  Segment_Array segments;
+} Argument_Plan;
+
+typedef struct {
+  Argument_Plan *ptr;
+  int len;
+  int cap;
+} Argument_Plans;
+
+// expanded words and the argv arrays holding them are allocated in
+// the given arena, nothing is freed one by one
+void expand_token(Token token, Arena *arena, String_Array *out);
+char **expand_argv(Token_Array argv, Arena *arena);
+Argument_Plan plan_argument(Token token);
+void expand_planned_argument(const Argument_Plan *plan, Arena *arena, String_Array *out);
+Value *planned_list(const Argument_Plan *plan);
+void free_argument_plan(Argument_Plan *plan);
+Argument_Plans plan_arguments(Token_Array argv);
+char **expand_planned_argv(const Argument_Plans *plans, Arena *arena);
+void free_argument_plans(Argument_Plans *plans);
+Z_String_View list_reference(Token token);
+void expand_aliases(Token_Array *tokens, Source *source, Arena *arena);
 
 #endif
@@ -1,59 +1,150 @@
 #include "interpreter.h"
+#include "arena.h"
+#include "ast_cache.h"
+#include "compiler.h"
 #include "config.h"
+#include "cstr.h"
+#include "error.h"
 #include "eval.h"
 #include "expantion.h"
 #include "libzatar.h"
+#include "output.h"
 #include "parser.h"
 #include "print_ast.h"
+#include "program.h"
+#include "source.h"
 #include "token.h"
+#include "vm.h"
 #include <endian.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-void interpret(const char *source)
+static Arena *current_arena = NULL;
+
+// the arena of the innermost interpret() call. commands expand their
+// arguments into it and release them once they ran.
+Arena *interpreter_arena()
+{
+  return current_arena;
+}
+
+static void run_program(Program *program, Statement_Array statements)
 {
   const Flint_Config *config = get_config();
 
-  Token_Array tokens = lexer_get_tokens(Z_CSTR(source));
-  expand_aliases(&tokens);
-  if (config->log_tokens) print_tokens(&tokens);
-  Statement_Array statements = parse(&tokens, source);
   if (config->log_statements) print_statements(statements);
-  free_tokens(&tokens);
-  evaluate_statements(statements);
-  free_statements(&statements);
+  Chunk chunk = compile(statements, program);
+  if (config->dump_bytecode) print_chunk(&chunk);
+  run_chunk(&chunk);
+  free_chunk(&chunk);
 }
 
-void interpret_to(Z_String_View source, Z_String *output)
+static Statement_Array parse_source(Source *source, Arena *arena)
+{
+  Token_Array tokens = lexer_get_tokens(source_view(source), arena);
+  expand_aliases(&tokens, source, arena);
+  if (get_config()->log_tokens) print_tokens(&tokens);
+
+  return parse(&tokens, source->text, arena);
+}
+
+static Program *begin_program(Arena **outer_arena)
+{
+  Program *program = program_create();
+  *outer_arena = current_arena;
+  current_arena = &program->arena;
+
+  return program;
+}
+
+// functions the program defined may still hold on to it, what they
+// don't need of the arena is given back now
+static void end_program(Program *program, Arena *outer_arena)
 {
-  int fd[2];
-  pipe(fd);
+  current_arena = outer_arena;
 
-  int saved_stdout = dup(STDOUT_FILENO);
-  dup2(fd[1], STDOUT_FILENO);
-  close(fd[1]);
+  if (program->refs > 1) {
+    arena_trim(&program->arena);
+  }
 
-  char *_source = strndup(source.ptr, source.len);
-  interpret(_source);
-  free(_source);
+  program_release(program);
+}
 
-  fflush(stdout);
+// the source is copied once, every token and AST node built from it
+// refers back into that copy. tokens, the AST and whatever the program
+// expands are allocated in one arena that goes away with the program.
+static void interpret_source(Z_String_View text)
+{
+  Arena *outer_arena;
+  Program *program = begin_program(&outer_arena);
 
-  dup2(saved_stdout, STDOUT_FILENO);
-  close(saved_stdout);
+  program->source = source_create(text);
+  run_program(program, parse_source(program->source, &program->arena));
 
-  FILE *fp = fdopen(fd[0], "r");
-  char buf[BUFSIZ];
+  end_program(program, outer_arena);
+}
 
-  while (fgets(buf, BUFSIZ, fp)) {
-    z_str_append_format(output, "%s", buf);
+static bool should_use_cache()
+{
+  const Flint_Config *config = get_config();
+
+  return !config->no_cache && !config->log_tokens;
+}
+
+// scripts are only lexed and parsed when their cached AST is missing
+// or stale, a script with syntax errors is never cached
+bool interpret_file(const char *path)
+{
+  struct stat st;
+
+  if (stat(path, &st) == -1 || !S_ISREG(st.st_mode)) {
+    return false;
   }
 
+  Arena *outer_arena;
+  Program *program = begin_program(&outer_arena);
+  Statement_Array statements = {0};
+
+  if (!should_use_cache() || !ast_cache_load(path, &st, &program->arena, &program->source, &statements)) {
+    char *content = str_read_file(path);
+
+    if (!content) {
+      end_program(program, outer_arena);
+      return false;
+    }
+
+    program->source = source_create(Z_CSTR(content));
+    free(content);
+
+    int errors_count = syntax_errors_count();
+    statements = parse_source(program->source, &program->arena);
+
+    if (should_use_cache() && syntax_errors_count() == errors_count) {
+      ast_cache_store(path, &st, program->source, statements);
+    }
+  }
+
+  run_program(program, statements);
+  end_program(program, outer_arena);
+
+  return true;
+}
+
+void interpret(const char *source)
+{
+  interpret_source(Z_CSTR(source));
+}
+
+void interpret_to(Z_String_View source, Z_String *output)
+{
+  output_begin_capture();
+  interpret_source(source);
+  output_end_capture(output);
+
   if (output->len > 0 && z_sv_top_char(Z_STR(*output)) == '\n') {
     z_str_pop_char(output);
   }
-
-  fclose(fp);
 }
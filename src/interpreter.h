@@ -1,9 +1,12 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include "arena.h"
 #include "libzatar.h"
 
 void interpret(const char *source);
+bool interpret_file(const char *path);
+Arena *interpreter_arena();
 void interpret_to(Z_String_View source, Z_String *output);
 
 #endif
@@ -0,0 +1,305 @@
+#include "job_table.h"
+#include "libzatar.h"
+#include "spawn.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef struct {
+  Job_Entry **ptr;
+  int len;
+  int cap;
+} Job_Entry_Array;
+
+static Job_Entry_Array jobs = {0};
+static bool interactive = false;
+
+// the handler only records that some child changed state, the jobs
+// are updated with non blocking waits the next time the shell looks
+static volatile sig_atomic_t children_changed = 0;
+
+static void on_sigchld(int signal)
+{
+  (void)signal;
+  children_changed = 1;
+}
+
+void jobs_initialize()
+{
+  struct sigaction action = {0};
+  action.sa_handler = on_sigchld;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGCHLD, &action, NULL);
+}
+
+// jobs are announced and finished ones reported only at the prompt
+void jobs_set_interactive()
+{
+  interactive = true;
+}
+
+// a forked child starts with no jobs of its own
+void jobs_reset()
+{
+  jobs.len = 0;
+}
+
+static void describe_job(const Job *job, Z_String *out)
+{
+  if (job == NULL) {
+    return;
+  }
+
+  switch (job->type) {
+    case JOB_COMMAND: {
+      const Job_Command *command = (const Job_Command *)job;
+      z_da_foreach(Token *, token, &command->argv) {
+        z_str_append_format(out, "%s%.*s", token == command->argv.ptr ? "" : " ", token->lexeme.len, token->lexeme.ptr);
+      }
+      break;
+    }
+
+    case JOB_PIPELINE: {
+      const Job_Pipeline *pipeline = (const Job_Pipeline *)job;
+      z_da_foreach(Job **, stage, &pipeline->stages) {
+        z_str_append_format(out, "%s", stage == pipeline->stages.ptr ? "" : " | ");
+        describe_job(*stage, out);
+      }
+      break;
+    }
+
+    case JOB_BINARY: {
+      const Job_Binary *binary = (const Job_Binary *)job;
+      describe_job(binary->left, out);
+      z_str_append_format(out, " %.*s ", binary->operator.lexeme.len, binary->operator.lexeme.ptr);
+      describe_job(binary->right, out);
+      break;
+    }
+
+    case JOB_UNARY:
+      describe_job(((const Job_Unary *)job)->child, out);
+      break;
+  }
+}
+
+Job_Entry *jobs_add(pid_t pid, const Job *job)
+{
+  Z_String command = {0};
+  describe_job(job, &command);
+
+  Job_Entry *entry = malloc(sizeof(Job_Entry));
+  entry->id = jobs.len > 0 ? z_da_peek(&jobs)->id + 1 : 1;
+  entry->pid = pid;
+  entry->state = JOB_STATE_RUNNING;
+  entry->status = 0;
+  entry->command = strdup(z_str_to_cstr(&command));
+  z_str_free(&command);
+
+  z_da_append(&jobs, entry);
+
+  if (interactive) {
+    fprintf(stderr, "[%d] %d\n", entry->id, pid);
+  }
+
+  return entry;
+}
+
+static void remove_job(Job_Entry *entry)
+{
+  for (int i = 0; i < jobs.len; i++) {
+    if (jobs.ptr[i] == entry) {
+      memmove(&jobs.ptr[i], &jobs.ptr[i + 1], (jobs.len - i - 1) * sizeof(Job_Entry *));
+      jobs.len--;
+      break;
+    }
+  }
+
+  free(entry->command);
+  free(entry);
+}
+
+// options is 0 to block until the job stops or ends, WNOHANG to only
+// pick up a change that already happened
+static bool update_job(Job_Entry *entry, int options)
+{
+  int status;
+  pid_t pid;
+
+  while ((pid = waitpid(entry->pid, &status, options | WUNTRACED | WCONTINUED)) < 0 && errno == EINTR) { }
+
+  if (pid <= 0) {
+    return false;
+  }
+
+  if (WIFSTOPPED(status)) {
+    entry->state = JOB_STATE_STOPPED;
+  } else if (WIFCONTINUED(status)) {
+    entry->state = JOB_STATE_RUNNING;
+  } else {
+    entry->state = JOB_STATE_DONE;
+    entry->status = status;
+  }
+
+  return true;
+}
+
+void jobs_reap()
+{
+  if (!children_changed) {
+    return;
+  }
+
+  children_changed = 0;
+
+  z_da_foreach(Job_Entry **, entry, &jobs) {
+    if ((*entry)->state != JOB_STATE_DONE) {
+      while (update_job(*entry, WNOHANG) && (*entry)->state != JOB_STATE_DONE) { }
+    }
+  }
+}
+
+static void print_job(FILE *stream, const Job_Entry *entry)
+{
+  char state[32];
+
+  if (entry->state == JOB_STATE_RUNNING) {
+    strcpy(state, "Running");
+  } else if (entry->state == JOB_STATE_STOPPED) {
+    strcpy(state, "Stopped");
+  } else if (exit_code(entry->status) == 0) {
+    strcpy(state, "Done");
+  } else {
+    snprintf(state, sizeof(state), "Exit %d", exit_code(entry->status));
+  }
+
+  fprintf(stream, "[%d]  %-10s %s\n", entry->id, state, entry->command);
+}
+
+// reports the jobs that finished since the last prompt and forgets them
+void jobs_notify()
+{
+  jobs_reap();
+
+  for (int i = 0; i < jobs.len; i++) {
+    if (jobs.ptr[i]->state == JOB_STATE_DONE) {
+      print_job(stderr, jobs.ptr[i]);
+      remove_job(jobs.ptr[i--]);
+    }
+  }
+}
+
+// listed jobs that are done have been reported and are forgotten
+void jobs_print(FILE *stream)
+{
+  jobs_reap();
+
+  for (int i = 0; i < jobs.len; i++) {
+    print_job(stream, jobs.ptr[i]);
+
+    if (jobs.ptr[i]->state == JOB_STATE_DONE) {
+      remove_job(jobs.ptr[i--]);
+    }
+  }
+}
+
+int jobs_count()
+{
+  return jobs.len;
+}
+
+// NULL is the most recent job, '%n' is job n and a plain number a pid
+Job_Entry *jobs_find(const char *spec)
+{
+  if (spec == NULL) {
+    return jobs.len > 0 ? z_da_peek(&jobs) : NULL;
+  }
+
+  bool by_id = spec[0] == '%';
+  char *end;
+  long n = strtol(spec + by_id, &end, 10);
+
+  if (*end != '\0' || end == spec + by_id) {
+    return NULL;
+  }
+
+  z_da_foreach(Job_Entry **, entry, &jobs) {
+    if (by_id ? (*entry)->id == n : (*entry)->pid == n) {
+      return *entry;
+    }
+  }
+
+  return NULL;
+}
+
+// blocks until the job is done and returns its wait status, like
+// wait_process. stopping it doesn't count, like it wouldn't for a
+// process.
+int jobs_wait(Job_Entry *entry)
+{
+  while (entry->state != JOB_STATE_DONE && update_job(entry, 0)) { }
+
+  int status = entry->state == JOB_STATE_DONE ? entry->status : W_EXITCODE(127, 0);
+  remove_job(entry);
+
+  return status;
+}
+
+int jobs_wait_all()
+{
+  while (jobs.len > 0) {
+    jobs_wait(jobs.ptr[0]);
+  }
+
+  return 0;
+}
+
+// SIGTTOU is blocked while the terminal changes hands, the shell may
+// not be in the foreground group when it takes the terminal back
+static void give_terminal(pid_t pgid)
+{
+  sigset_t block, old;
+  sigemptyset(&block);
+  sigaddset(&block, SIGTTOU);
+  sigprocmask(SIG_BLOCK, &block, &old);
+  tcsetpgrp(STDIN_FILENO, pgid);
+  sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+int jobs_foreground(Job_Entry *entry)
+{
+  bool terminal = interactive && isatty(STDIN_FILENO);
+
+  fprintf(stderr, "%s\n", entry->command);
+
+  if (terminal) {
+    give_terminal(entry->pid);
+  }
+
+  kill(-entry->pid, SIGCONT);
+  entry->state = JOB_STATE_RUNNING;
+
+  while (entry->state == JOB_STATE_RUNNING && update_job(entry, 0)) { }
+
+  if (terminal) {
+    give_terminal(getpgrp());
+  }
+
+  if (entry->state == JOB_STATE_STOPPED) {
+    print_job(stderr, entry);
+    return W_EXITCODE(128 + SIGTSTP, 0);
+  }
+
+  return jobs_wait(entry);
+}
+
+void jobs_background(Job_Entry *entry)
+{
+  kill(-entry->pid, SIGCONT);
+  entry->state = JOB_STATE_RUNNING;
+  fprintf(stderr, "[%d] %s &\n", entry->id, entry->command);
+}
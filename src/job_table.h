@@ -0,0 +1,39 @@
+#ifndef JOB_TABLE_H
+#define JOB_TABLE_H
+
+#include "ast.h"
+#include <stdio.h>
+#include <sys/types.h>
+
+typedef enum {
+  JOB_STATE_RUNNING,
+  JOB_STATE_STOPPED,
+  JOB_STATE_DONE,
+} Job_State;
+
+// a background job is one forked copy of the shell, which leads its
+// own process group, so every process it starts belongs to the job.
+// status is the wait status once the job is done.
+typedef struct {
+  int id;
+  pid_t pid;
+  Job_State state;
+  int status;
+  char *command;
+} Job_Entry;
+
+void jobs_initialize();
+void jobs_set_interactive();
+void jobs_reset();
+Job_Entry *jobs_add(pid_t pid, const Job *job);
+void jobs_reap();
+void jobs_notify();
+void jobs_print(FILE *stream);
+Job_Entry *jobs_find(const char *spec);
+int jobs_count();
+int jobs_wait(Job_Entry *entry);
+int jobs_wait_all();
+int jobs_foreground(Job_Entry *entry);
+void jobs_background(Job_Entry *entry);
+
+#endif
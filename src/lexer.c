@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "arena.h"
 #include "builtins/builtin.h"
 #include "cstr.h"
 #include "error.h"
@@ -11,58 +12,163 @@
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct {
-  bool had_error;
-  Z_Scanner scanner;
-} Lexer_State;
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 
-Lexer_State *lexer_state = NULL;
-
-void lexer_init(Z_String_View source)
+void lexer_init(Lexer *lexer, Z_String_View source)
 {
-  lexer_state = malloc(sizeof(Lexer_State));
-  lexer_state->had_error = false;
-  lexer_state->scanner = z_scanner_new(source);
+  lexer->had_error = false;
+  lexer->scanner = z_scanner_new(source);
 }
 
-void lexer_free()
-{
-  free(lexer_state);
-  lexer_state = NULL;
-}
-
-static void lexer_error(const char *fmt, ...)
+static void lexer_error(Lexer *lexer, const char *fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
   syntax_error_va(fmt, ap);
-  lexer_state->had_error = true;
+  lexer->had_error = true;
   va_end(ap);
 }
 
+// the libzatar scanner queries take the scanner by value, which copies
+// it on every byte. these read it in place.
+static bool scanner_at_end(const Z_Scanner *scanner)
+{
+  return scanner->end >= scanner->source.len;
+}
+
+static char scanner_peek(const Z_Scanner *scanner)
+{
+  return scanner->source.ptr[scanner->end];
+}
+
+static char scanner_previous(const Z_Scanner *scanner)
+{
+  return scanner->source.ptr[scanner->end - 1];
+}
+
+static bool scanner_check_string(const Z_Scanner *scanner, Z_String_View s)
+{
+  return scanner->end + s.len <= scanner->source.len && !memcmp(scanner->source.ptr + scanner->end, s.ptr, s.len);
+}
+
+static bool scanner_match(Z_Scanner *scanner, char c)
+{
+  if (scanner_at_end(scanner) || scanner_peek(scanner) != c) {
+    return false;
+  }
+
+  z_scanner_advance(scanner);
+
+  return true;
+}
+
+static bool scanner_match_string(Z_Scanner *scanner, Z_String_View s)
+{
+  if (!scanner_check_string(scanner, s)) {
+    return false;
+  }
+
+  scanner->end += s.len;
+
+  return true;
+}
+
+static Z_String_View scanner_capture(const Z_Scanner *scanner)
+{
+  return Z_SV(scanner->source.ptr + scanner->start, scanner->end - scanner->start);
+}
+
+#define CLASS_WHITESPACE 1
+#define CLASS_SPECIAL    2
+
+// bytes that end an argument are special, NUL included
+static const unsigned char char_class[256] = {
+  ['\0'] = CLASS_SPECIAL,
+  [' ']  = CLASS_WHITESPACE | CLASS_SPECIAL,
+  ['\t'] = CLASS_WHITESPACE,
+  ['\r'] = CLASS_WHITESPACE,
+  ['\n'] = CLASS_SPECIAL,
+  ['&']  = CLASS_SPECIAL,
+  ['|']  = CLASS_SPECIAL,
+  [';']  = CLASS_SPECIAL,
+  ['(']  = CLASS_SPECIAL,
+  [')']  = CLASS_SPECIAL,
+  ['"']  = CLASS_SPECIAL,
+  ['\''] = CLASS_SPECIAL,
+};
+
 bool is_whitespace(char c)
 {
-  return strchr(" \t\r", c) != NULL;
+  return char_class[(unsigned char)c] & CLASS_WHITESPACE;
 }
 
 static bool is_argument_char(char c)
 {
-  return strchr(" &|;()\n\"'", c) == NULL;
+  return !(char_class[(unsigned char)c] & CLASS_SPECIAL);
 }
 
-void skip_whitespaces()
+#ifdef __SSE2__
+// a 16 bit mask of the special bytes among the 16 at p
+static unsigned special_mask(const char *p)
 {
-  while (!z_scanner_is_at_end(lexer_state->scanner) && is_whitespace(z_scanner_peek(lexer_state->scanner))) {
-    z_scanner_advance(&lexer_state->scanner);
+  __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+  __m128i special = _mm_cmpeq_epi8(bytes, _mm_setzero_si128());
+
+  static const char specials[] = " \n&|;()\"'";
+
+  for (size_t i = 0; i < sizeof(specials) - 1; i++) {
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(specials[i])));
   }
 
-  z_scanner_reset_mark(&lexer_state->scanner);
+  return _mm_movemask_epi8(special);
+}
+#endif
+
+// the length of the run of argument bytes at the scanner, which holds
+// no newline, so the scanner can jump over it without counting lines.
+// runs of 16 bytes or more are checked 16 at a time.
+static int argument_run(const Z_Scanner *scanner)
+{
+  const char *start = scanner->source.ptr + scanner->end;
+  const char *end = scanner->source.ptr + scanner->source.len;
+  const char *p = start;
+
+#ifdef __SSE2__
+  while (end - p >= 16) {
+    unsigned mask = special_mask(p);
+
+    if (mask) {
+      return p - start + __builtin_ctz(mask);
+    }
+
+    p += 16;
+  }
+#endif
+
+  while (p < end && is_argument_char(*p)) {
+    p++;
+  }
+
+  return p - start;
+}
+
+void skip_whitespaces(Lexer *lexer)
+{
+  Z_Scanner *scanner = &lexer->scanner;
+
+  while (scanner->end < scanner->source.len && is_whitespace(scanner->source.ptr[scanner->end])) {
+    scanner->end++;
+  }
+
+  z_scanner_reset_mark(scanner);
 }
 
 static Token make_token(Z_String_View lexeme, Token_Type type, int line, int column)
 {
   Token token = {
-      .lexeme = z_sv_to_cstr(lexeme),
+      .lexeme = lexeme,
       .type = type,
       .line = line,
       .column = column,
@@ -71,203 +177,261 @@ static Token make_token(Z_String_View lexeme, Token_Type type, int line, int col
   return token;
 }
 
-static Token make_token_from_state(Token_Type type)
+static Token make_token_from_state(Lexer *lexer, Token_Type type)
 {
+  const Z_Scanner *scanner = &lexer->scanner;
+
   Token token = {
-      .lexeme = z_sv_to_cstr(z_scanner_capture(lexer_state->scanner)),
+      .lexeme = scanner_capture(scanner),
       .type = type,
-      .line = lexer_state->scanner.line,
-      .column = lexer_state->scanner.column,
+      .line = scanner->line,
+      .column = scanner->column,
   };
 
   return token;
 }
 
-static void advance_command_substitution();
-static void advance_double_quoted_string();
+static void advance_command_substitution(Lexer *lexer);
+static void advance_double_quoted_string(Lexer *lexer);
 
 static void advance_untill(Z_Scanner *scanner, Z_String_View s)
 {
-  while (!z_scanner_is_at_end(*scanner) && !z_scanner_check_string(*scanner, s)) {
+  while (!scanner_at_end(scanner) && !scanner_check_string(scanner, s)) {
     z_scanner_advance(scanner);
   }
 }
 
-static void advance_command_substitution()
+static void advance_command_substitution(Lexer *lexer)
 {
-  while (!z_scanner_is_at_end(lexer_state->scanner)) {
-    switch (z_scanner_advance(&lexer_state->scanner)) {
+  while (!scanner_at_end(&lexer->scanner)) {
+    switch (z_scanner_advance(&lexer->scanner)) {
       case '(':
-        advance_command_substitution();
+        advance_command_substitution(lexer);
         break;
 
       case ')':
         return;
 
       case '\'':
-        advance_untill(&lexer_state->scanner, Z_CSTR("'"));
-        if (!z_scanner_is_at_end(lexer_state->scanner)) z_scanner_advance(&lexer_state->scanner);      
+        advance_untill(&lexer->scanner, Z_CSTR("'"));
+        if (!scanner_at_end(&lexer->scanner)) z_scanner_advance(&lexer->scanner);      
         break;
 
       case '"':
-          advance_double_quoted_string(&lexer_state->scanner);
-          if (!z_scanner_is_at_end(lexer_state->scanner)) z_scanner_advance(&lexer_state->scanner);        
+          advance_double_quoted_string(lexer);
+          if (!scanner_at_end(&lexer->scanner)) z_scanner_advance(&lexer->scanner);        
           break;
     }
   }
 }
 
-static void advance_double_quoted_string()
+static void advance_double_quoted_string(Lexer *lexer)
 {
-  while (!z_scanner_is_at_end(lexer_state->scanner) && !z_scanner_check(lexer_state->scanner, '"')) {
-    if (z_scanner_match_string(&lexer_state->scanner, Z_CSTR("$("))) {
-      advance_command_substitution();
+  Z_Scanner *scanner = &lexer->scanner;
+
+  while (scanner->end < scanner->source.len) {
+    char c = scanner->source.ptr[scanner->end];
+
+    if (c == '"') {
+      return;
+    }
+
+    if (c == '$' && scanner->end + 1 < scanner->source.len && scanner->source.ptr[scanner->end + 1] == '(') {
+      scanner->end += 2;
+      advance_command_substitution(lexer);
+    } else if (c == '\n') {
+      z_scanner_advance(scanner);
     } else {
-      z_scanner_advance(&lexer_state->scanner);
+      scanner->end++;
     }
   }
 }
 
-Token multi_double_quoted_string()
+Token multi_double_quoted_string(Lexer *lexer)
 {
-  z_scanner_match(&lexer_state->scanner, '\n');
-  z_scanner_reset_mark(&lexer_state->scanner);
+  scanner_match(&lexer->scanner, '\n');
+  z_scanner_reset_mark(&lexer->scanner);
 
-  advance_untill(&lexer_state->scanner, Z_CSTR("\"\"\""));
+  advance_untill(&lexer->scanner, Z_CSTR("\"\"\""));
 
-  if (z_scanner_is_at_end(lexer_state->scanner)) {
-    lexer_error("Unexpected end of file while looking for matching '\"\"\"'");
-    return make_token_from_state(TOKEN_ERROR);
+  if (scanner_at_end(&lexer->scanner)) {
+    lexer_error(lexer, "Unexpected end of file while looking for matching '\"\"\"'");
+    return make_token_from_state(lexer, TOKEN_ERROR);
   }
 
-  Z_String_View string = z_scanner_capture(lexer_state->scanner);
+  Z_String_View string = scanner_capture(&lexer->scanner);
 
   if (z_sv_ends_with(string, Z_CSTR("\n"))) {
     string.len--;
   }
 
-  Token token = make_token(string, TOKEN_DQUOTED_STRING, lexer_state->scanner.line, lexer_state->scanner.column);
-  lexer_state->scanner.end += 3;
+  Token token = make_token(string, TOKEN_DQUOTED_STRING, lexer->scanner.line, lexer->scanner.column);
+  lexer->scanner.end += 3;
 
   return token;
 }
 
-Token double_quoted_string()
+Token double_quoted_string(Lexer *lexer)
 {
-  z_scanner_reset_mark(&lexer_state->scanner);
-  advance_double_quoted_string();
+  z_scanner_reset_mark(&lexer->scanner);
+  advance_double_quoted_string(lexer);
 
-  if (z_scanner_is_at_end(lexer_state->scanner)) {
-    lexer_error("Unexpected end of file while looking for matching \"");
-    return make_token_from_state(TOKEN_ERROR);
+  if (scanner_at_end(&lexer->scanner)) {
+    lexer_error(lexer, "Unexpected end of file while looking for matching \"");
+    return make_token_from_state(lexer, TOKEN_ERROR);
   }
 
-  Token token = make_token_from_state(TOKEN_DQUOTED_STRING);
-  z_scanner_advance(&lexer_state->scanner);
+  Token token = make_token_from_state(lexer, TOKEN_DQUOTED_STRING);
+  z_scanner_advance(&lexer->scanner);
 
   return token;
 }
 
-Token single_quoted_string()
+Token single_quoted_string(Lexer *lexer)
 {
-  z_scanner_reset_mark(&lexer_state->scanner);
-  advance_untill(&lexer_state->scanner, Z_CSTR("'"));
+  z_scanner_reset_mark(&lexer->scanner);
+  advance_untill(&lexer->scanner, Z_CSTR("'"));
 
-  if (z_scanner_is_at_end(lexer_state->scanner)) {
-    lexer_error("Unexpected end of file while looking for matching '");
-    return make_token_from_state(TOKEN_ERROR);
+  if (scanner_at_end(&lexer->scanner)) {
+    lexer_error(lexer, "Unexpected end of file while looking for matching '");
+    return make_token_from_state(lexer, TOKEN_ERROR);
   }
 
-  Token token = make_token_from_state(TOKEN_SQUOTED_STRING);
-  z_scanner_advance(&lexer_state->scanner);
+  Token token = make_token_from_state(lexer, TOKEN_SQUOTED_STRING);
+  z_scanner_advance(&lexer->scanner);
 
   return token;
 }
 
-Token argument()
+Token argument(Lexer *lexer)
 {
-  while (!z_scanner_is_at_end(lexer_state->scanner)) {
-    if (z_scanner_previous(lexer_state->scanner) == '$' && z_scanner_match(&lexer_state->scanner, '(')) {
-      advance_command_substitution();
-    } else if (is_argument_char(z_scanner_peek(lexer_state->scanner))) {
-      z_scanner_advance(&lexer_state->scanner);
+  Z_Scanner *scanner = &lexer->scanner;
+
+  while (scanner->end < scanner->source.len) {
+    scanner->end += argument_run(scanner);
+
+    if (scanner->end < scanner->source.len && scanner_previous(scanner) == '$' && scanner_match(scanner, '(')) {
+      advance_command_substitution(lexer);
     } else {
       break;
     }
   }
 
-  Z_String_View arg = z_scanner_capture(lexer_state->scanner);
+  Z_String_View arg = scanner_capture(&lexer->scanner);
 
-  return make_token_from_state(get_keyword_type(arg, TOKEN_WORD));
+  return make_token_from_state(lexer, get_keyword_type(arg, TOKEN_WORD));
 }
 
-void skip_comment()
+// a redirection only starts a token: [n]>, [n]>>, [n]< or [n]>&m.
+// '>=' and '<=' stay words, they are operators of test.
+static bool check_redirection(const Z_Scanner *scanner)
 {
-  while (!z_scanner_is_at_end(lexer_state->scanner) && !z_scanner_check(lexer_state->scanner, '\n')) {
-    z_scanner_advance(&lexer_state->scanner);
+  const char *p = scanner->source.ptr + scanner->end;
+  const char *end = scanner->source.ptr + scanner->source.len;
+
+  while (p < end && isdigit((unsigned char)*p)) {
+    p++;
   }
+
+  if (p == end || (*p != '>' && *p != '<')) {
+    return false;
+  }
+
+  p++;
+
+  return p == end || *p != '=';
 }
 
-Token lexer_next()
+Token redirection(Lexer *lexer)
 {
-  skip_whitespaces(&lexer_state->scanner);
+  while (isdigit(scanner_peek(&lexer->scanner))) {
+    z_scanner_advance(&lexer->scanner);
+  }
+
+  if (z_scanner_advance(&lexer->scanner) == '>' && !scanner_match(&lexer->scanner, '>')
+      && scanner_match(&lexer->scanner, '&')) {
+    if (scanner_at_end(&lexer->scanner) || !isdigit(scanner_peek(&lexer->scanner))) {
+      lexer_error(lexer, "Expected a file descriptor after '>&'");
+      return make_token_from_state(lexer, TOKEN_ERROR);
+    }
 
-  if (z_scanner_is_at_end(lexer_state->scanner)) {
-    return make_token_from_state(TOKEN_EOD);
+    while (!scanner_at_end(&lexer->scanner) && isdigit(scanner_peek(&lexer->scanner))) {
+      z_scanner_advance(&lexer->scanner);
+    }
   }
 
-  char c = z_scanner_advance(&lexer_state->scanner);
+  return make_token_from_state(lexer, TOKEN_REDIRECT);
+}
+
+void skip_comment(Lexer *lexer)
+{
+  Z_Scanner *scanner = &lexer->scanner;
+  const char *newline = memchr(scanner->source.ptr + scanner->end, '\n', scanner->source.len - scanner->end);
+  scanner->end = newline ? newline - scanner->source.ptr : scanner->source.len;
+}
+
+Token lexer_next(Lexer *lexer)
+{
+  skip_whitespaces(lexer);
+
+  if (scanner_at_end(&lexer->scanner)) {
+    return make_token_from_state(lexer, TOKEN_EOD);
+  }
+
+  if (check_redirection(&lexer->scanner)) {
+    return redirection(lexer);
+  }
+
+  char c = z_scanner_advance(&lexer->scanner);
 
   switch (c) {
     case '|':
-      return make_token_from_state(z_scanner_match(&lexer_state->scanner, '|') ? TOKEN_OR : TOKEN_PIPE);
+      return make_token_from_state(lexer, scanner_match(&lexer->scanner, '|') ? TOKEN_OR : TOKEN_PIPE);
 
     case '&':
-      return make_token_from_state(z_scanner_match(&lexer_state->scanner, '&') ? TOKEN_AND : TOKEN_AMPERSAND);
+      return make_token_from_state(lexer, scanner_match(&lexer->scanner, '&') ? TOKEN_AND : TOKEN_AMPERSAND);
 
     case '\'':
-      return single_quoted_string(&lexer_state->scanner);
+      return single_quoted_string(lexer);
 
     case '"':
-      return z_scanner_match_string(&lexer_state->scanner, Z_CSTR("\"\"")) ? multi_double_quoted_string() : double_quoted_string();
+      return scanner_match_string(&lexer->scanner, Z_CSTR("\"\"")) ? multi_double_quoted_string(lexer) : double_quoted_string(lexer);
 
     case '#':
-      skip_comment();
-      return lexer_next();
+      skip_comment(lexer);
+      return lexer_next(lexer);
 
     case ';':
-      return make_token_from_state(TOKEN_STATEMENT_END);
+      return make_token_from_state(lexer, TOKEN_STATEMENT_END);
 
     case '\n':
-      return make_token_from_state(TOKEN_STATEMENT_END);
+      return make_token_from_state(lexer, TOKEN_STATEMENT_END);
 
     default:
-      return argument();
+      return argument(lexer);
   }
 }
 
-Token_Array lexer_get_tokens(Z_String_View source)
+// the token array lives in arena, the lexemes in source
+Token_Array lexer_get_tokens(Z_String_View source, Arena *arena)
 {
-  lexer_init(source);
+  Lexer lexer;
+  lexer_init(&lexer, source);
 
   Token_Array tokens = {0};
-  Token token = lexer_next();
+  Token token = lexer_next(&lexer);
 
   while (token.type != TOKEN_EOD) {
-    z_da_append(&tokens, token);
-    token = lexer_next();
+    arena_da_append(arena, &tokens, token);
+    token = lexer_next(&lexer);
   }
 
-  z_da_append(&tokens, token);
+  arena_da_append(arena, &tokens, token);
 
-  if (lexer_state->had_error) {
+  if (lexer.had_error) {
     tokens.len = 0;
-    z_da_append(&tokens, make_token_from_state(TOKEN_EOD));
-    lexer_free();
-    return tokens;
+    arena_da_append(arena, &tokens, make_token_from_state(&lexer, TOKEN_EOD));
   }
 
-  lexer_free();
   return tokens;
 }
-
@@ -1,9 +1,20 @@
 #ifndef LEXEL_H
 #define LEXEL_H
 
+#include "arena.h"
 #include "libzatar.h"
 #include "token.h"
+#include <stdbool.h>
 
-Token_Array lexer_get_tokens(Z_String_View source);
+// everything a lexer works on lives here, so sources can be lexed on
+// several threads, or while another lexer is halfway through
+typedef struct {
+  bool had_error;
+  Z_Scanner scanner;
+} Lexer;
+
+void lexer_init(Lexer *lexer, Z_String_View source);
+Token lexer_next(Lexer *lexer);
+Token_Array lexer_get_tokens(Z_String_View source, Arena *arena);
 
 #endif
@@ -11,6 +11,7 @@
 #include <unistd.h>
 
 #include "interpreter.h"
+#include "job_table.h"
 #include "state.h"
 #include "cstr.h"
 #include "config.h"
@@ -35,6 +36,7 @@ char *get_prompt()
 
 void repl()
 {
+  jobs_set_interactive();
   char *prompt = get_prompt();
 
   for (char *line = readline(prompt); line; line = readline(prompt)) {
@@ -42,6 +44,7 @@ void repl()
     interpret(line);
     free(line);
     free(prompt);
+    jobs_notify();
     prompt = get_prompt();
   }
 
@@ -51,30 +54,49 @@ void repl()
 void execute_file(const char *pathname)
 {
   char *expanded_path = str_expand_tilde(pathname);
-  char *content = str_read_file(expanded_path);
+  bool found = interpret_file(expanded_path);
   free(expanded_path);
 
-  if (!content) {
+  if (!found) {
     z_print_warning("Flint: No such file or directory: '%s'", pathname);
-    return;
   }
+}
 
-  interpret(content);
-  free(content);
+void log_lookups()
+{
+  const Lookup_Counters *lookups = select_lookup_counters();
+  fflush(stdout);
+  fprintf(stderr, "variable lookups: %ld resolved, %ld dynamic\n", lookups->resolved, lookups->dynamic);
 }
 
 int main(int argc, char **argv)
 {
   initialize_config(argc, argv);
   initialize_state();
+  jobs_initialize();
+
+  if (get_config()->log_lookups) {
+    atexit(log_lookups);
+  }
+
   execute_file(INIT_FILE_PATH);
 
-  if (argc == 1) {
+  // options were already consumed by initialize_config
+  char *operands[argc];
+  int operands_count = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--", 2) != 0) {
+      operands[operands_count++] = argv[i];
+    }
+  }
+
+  if (operands_count == 0) {
     repl();
-  } else if (argc == 2) {
-    execute_file(argv[1]);
+  } else if (operands_count == 1) {
+    execute_file(operands[0]);
   } else {
-    z_die_format("Flint: Usage: Flint <path>\n");
+    z_die_format("Flint: Usage: Flint [options] <path>\n");
   }
 }
 
@@ -0,0 +1,120 @@
+#include "output.h"
+#include "libzatar.h"
+#include "spawn.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define COLLECT_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+  FILE *stream;
+  char *buffer;
+  size_t size;
+} Capture;
+
+typedef struct {
+  Capture **ptr;
+  int len;
+  int cap;
+} Capture_Array;
+
+// active command substitutions, innermost last. builtins write to the
+// innermost one directly, so no pipe is needed unless a child process
+// is part of the substitution.
+static Capture_Array captures = {0};
+
+FILE *output_stream()
+{
+  return captures.len > 0 ? z_da_peek(&captures)->stream : stdout;
+}
+
+bool output_is_captured()
+{
+  return captures.len > 0;
+}
+
+void output_begin_capture()
+{
+  // the stream keeps pointers to buffer and size, so the capture
+  // itself can't move around with the array
+  Capture *capture = malloc(sizeof(Capture));
+  capture->stream = open_memstream(&capture->buffer, &capture->size);
+  z_da_append(&captures, capture);
+}
+
+// builtins write to stream until the matching output_end_stream, the
+// caller owns the stream
+void output_begin_stream(FILE *stream)
+{
+  Capture *capture = calloc(1, sizeof(Capture));
+  capture->stream = stream;
+  z_da_append(&captures, capture);
+}
+
+void output_end_stream()
+{
+  free(z_da_pop(&captures));
+}
+
+void output_end_capture(Z_String *output)
+{
+  Capture *capture = z_da_pop(&captures);
+  fclose(capture->stream);
+  z_da_ensure_capacity(output, output->len + (int)capture->size + 1);
+  memcpy(output->ptr + output->len, capture->buffer, capture->size);
+  output->len += capture->size;
+  free(capture->buffer);
+  free(capture);
+}
+
+// a forked child writes to its own stdout, which the parent has already
+// pointed at the right place. the parent's memory streams are just a copy.
+void output_reset()
+{
+  captures.len = 0;
+}
+
+int output_child_fd(int *collect_fd)
+{
+  if (!output_is_captured()) {
+    *collect_fd = -1;
+    return STDOUT_FILENO;
+  }
+
+  int fd[2];
+  open_pipe(fd);
+  *collect_fd = fd[0];
+
+  return fd[1];
+}
+
+void output_collect(int collect_fd, int child_fd)
+{
+  if (collect_fd < 0) {
+    return;
+  }
+
+  close(child_fd);
+
+  FILE *stream = output_stream();
+  char *buffer = malloc(COLLECT_BUFFER_SIZE);
+  ssize_t n;
+
+  while ((n = read(collect_fd, buffer, COLLECT_BUFFER_SIZE)) != 0) {
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      break;
+    }
+
+    fwrite(buffer, 1, n, stream);
+  }
+
+  free(buffer);
+  close(collect_fd);
+}
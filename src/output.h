@@ -0,0 +1,18 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "libzatar.h"
+#include <stdio.h>
+
+FILE *output_stream();
+bool output_is_captured();
+void output_begin_capture();
+void output_end_capture(Z_String *output);
+void output_begin_stream(FILE *stream);
+void output_end_stream();
+void output_reset();
+
+int output_child_fd(int *collect_fd);
+void output_collect(int collect_fd, int child_fd);
+
+#endif
@@ -5,73 +5,64 @@
 #include "libzatar.h"
 #include "token.h"
 #include <assert.h>
+#include <ctype.h>
 #include <setjmp.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-Statement *parse_statement();
+Statement *parse_statement(Parser *parser);
 
-typedef struct {
-  const Token_Array *tokens;
-  int curr;
-  bool had_error;
-  bool panic_mode;
-  const char *source;
-  char **source_by_lines;
-} Parser_State;
-
-static Parser_State *parser_state = NULL;
-
-void parser_init(const Token_Array *tokens, const char *source)
+void parser_init(Parser *parser, const Token_Array *tokens, const char *source, Arena *arena)
 {
-  parser_state = malloc(sizeof(Parser_State));
-  parser_state->tokens = tokens;
-  parser_state->curr = 0;
-  parser_state->had_error = false;
-  parser_state->panic_mode = false;
-  parser_state->source = source;
-  parser_state->source_by_lines = str_split(source, "\n");
+  parser->tokens = tokens;
+  parser->curr = 0;
+  parser->had_error = false;
+  parser->panic_mode = false;
+  parser->source = source;
+  parser->source_by_lines = NULL;
+  parser->arena = arena;
 }
 
-void parser_free()
+void parser_free(Parser *parser)
 {
-  str_free_array(parser_state->source_by_lines);
-  free(parser_state);
-  parser_state = NULL;
+  if (parser->source_by_lines) {
+    str_free_array(parser->source_by_lines);
+    parser->source_by_lines = NULL;
+  }
 }
 
-static Token advance()
+static Token advance(Parser *parser)
 {
-  assert(parser_state->curr < parser_state->tokens->len);
-  return parser_state->tokens->ptr[parser_state->curr++];
+  assert(parser->curr < parser->tokens->len);
+  return parser->tokens->ptr[parser->curr++];
 }
 
-static Token peek()
+static Token peek(Parser *parser)
 {
-  assert(parser_state->curr < parser_state->tokens->len);
-  return parser_state->tokens->ptr[parser_state->curr];
+  assert(parser->curr < parser->tokens->len);
+  return parser->tokens->ptr[parser->curr];
 }
 
-static bool is_at_end()
+static bool is_at_end(Parser *parser)
 {
-  return peek().type == TOKEN_EOD;
+  return peek(parser).type == TOKEN_EOD;
 }
 
-static bool check(Token_Type type)
+static bool check(Parser *parser, Token_Type type)
 {
-  if (parser_state->panic_mode) {
+  if (parser->panic_mode) {
     return false;
   }
 
-  return peek().type == type;
+  return peek(parser).type == type;
 }
 
-static bool check_array(Token_Type *types, int len)
+static bool check_array(Parser *parser, Token_Type *types, int len)
 {
   for (int i = 0; i < len; i++) {
-    if (check(types[i])) {
+    if (check(parser, types[i])) {
       return true;
     }
   }
@@ -79,18 +70,18 @@ static bool check_array(Token_Type *types, int len)
   return false;
 }
 
-static bool check_keyword()
+static bool check_keyword(Parser *parser)
 {
-#define X(type, lexeme, is_keyword) \
-  if (is_keyword && check(type)) {  \
-     return true;                   \
+#define X(type, lexeme, is_keyword)         \
+  if (is_keyword && check(parser, type)) {  \
+     return true;                           \
   }
     TOKEN_TYPES
 #undef X
   return false;
 }
 
-static bool check_string()
+static bool check_string(Parser *parser)
 {
   Token_Type string_types[] = {
     TOKEN_WORD,
@@ -98,280 +89,340 @@ static bool check_string()
     TOKEN_SQUOTED_STRING,
   };
 
-  return check_array(string_types, Z_ARRAY_LEN(string_types));
+  return check_array(parser, string_types, Z_ARRAY_LEN(string_types));
 }
 
-static bool check_argument() {
+static bool check_argument(Parser *parser) {
   // argument override keywords
   // for example:
   // echo if
-  return check_string() || check_keyword();
+  return check_string(parser) || check_keyword(parser);
 }
 
-static bool match(Token_Type type)
+static bool match(Parser *parser, Token_Type type)
 {
-  if (parser_state->had_error) {
+  if (parser->had_error) {
     return false;
   }
 
-  if (check(type)) {
-    advance();
+  if (check(parser, type)) {
+    advance(parser);
     return true;
   }
 
   return false;
 }
 
-static void parser_error(Token token, const char *fmt, ...)
+static void parser_error(Parser *parser, Token token, const char *fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
 
-  if (!parser_state->panic_mode) {
-    syntax_error_at_token_va((const char *const *)parser_state->source_by_lines, token, fmt, ap);
+  // only split the source into lines once there is something to show
+  if (!parser->source_by_lines) {
+    parser->source_by_lines = str_split(parser->source, "\n");
   }
 
-  parser_state->had_error = true;
-  parser_state->panic_mode = true;
+  if (!parser->panic_mode) {
+    syntax_error_at_token_va((const char *const *)parser->source_by_lines, token, fmt, ap);
+  }
+
+  parser->had_error = true;
+  parser->panic_mode = true;
   va_end(ap);
 }
 
-Token consume(Token_Type type, const char *msg)
+Token consume(Parser *parser, Token_Type type, const char *msg)
 {
-  if (check(type)) {
-    return advance();
+  if (check(parser, type)) {
+    return advance(parser);
   }
 
-  parser_error(peek(), msg);
+  parser_error(parser, peek(parser), msg);
 
-  return peek();
+  return peek(parser);
 }
 
-Token consume_string(const char *msg)
+Token consume_string(Parser *parser, const char *msg)
 {
-  if (check_string()) {
-    return advance();
+  if (check_string(parser)) {
+    return advance(parser);
   }
 
-  parser_error(peek(), msg);
+  parser_error(parser, peek(parser), msg);
 
-  return peek();
+  return peek(parser);
 }
 
-Token consume_argument(const char *msg)
+Token consume_argument(Parser *parser, const char *msg)
 {
-  if (check_argument()) {
-    return advance();
+  if (check_argument(parser)) {
+    return advance(parser);
   }
 
-  parser_error(peek(), msg);
+  parser_error(parser, peek(parser), msg);
+
+  return peek(parser);
+}
 
-  return peek();
+void skip_empty_statements(Parser *parser)
+{
+  while (!is_at_end(parser) && match(parser, TOKEN_STATEMENT_END)) { }
 }
 
-void skip_empty_statements()
+void synchronize(Parser *parser)
 {
-  while (!is_at_end() && match(TOKEN_STATEMENT_END)) { }
+  skip_empty_statements(parser);
+  while (!is_at_end(parser) && advance(parser).type != TOKEN_STATEMENT_END) { }
+  parser->panic_mode = false;
 }
 
-void synchronize()
+Redirect parse_redirect(Parser *parser)
 {
-  skip_empty_statements();
-  while (!is_at_end() && advance().type != TOKEN_STATEMENT_END) { }
-  parser_state->panic_mode = false;
+  Token operator = advance(parser);
+  Z_String_View lexeme = operator.lexeme;
+  Redirect redirect = {0};
+  int i = 0;
+
+  while (i < lexeme.len && isdigit(lexeme.ptr[i])) {
+    redirect.fd = redirect.fd * 10 + lexeme.ptr[i++] - '0';
+  }
+
+  bool has_fd = i > 0;
+
+  if (lexeme.ptr[i] == '<') {
+    redirect.type = REDIRECT_INPUT;
+    redirect.fd = has_fd ? redirect.fd : 0;
+  } else if (i + 1 < lexeme.len && lexeme.ptr[i + 1] == '>') {
+    redirect.type = REDIRECT_APPEND;
+    redirect.fd = has_fd ? redirect.fd : 1;
+  } else if (i + 1 < lexeme.len && lexeme.ptr[i + 1] == '&') {
+    redirect.type = REDIRECT_DUPLICATE;
+    redirect.fd = has_fd ? redirect.fd : 1;
+    redirect.target_fd = atoi(lexeme.ptr + i + 2);
+  } else {
+    redirect.type = REDIRECT_OUTPUT;
+    redirect.fd = has_fd ? redirect.fd : 1;
+  }
+
+  if (redirect.type != REDIRECT_DUPLICATE) {
+    redirect.target = consume_argument(parser, "Expected file name after redirection.");
+  }
+
+  return redirect;
 }
 
-Job *parse_simple_command()
+Job *parse_simple_command(Parser *parser)
 {
   Token_Array argv = {0};
+  Redirect_Array redirects = {0};
 
-  while (check_argument()) {
-    Token token = advance();
-    z_da_append(&argv, clone_token(token));
+  while (check_argument(parser) || check(parser, TOKEN_REDIRECT)) {
+    if (check(parser, TOKEN_REDIRECT)) {
+      arena_da_append(parser->arena, &redirects, parse_redirect(parser));
+    } else {
+      arena_da_append(parser->arena, &argv, advance(parser));
+    }
   }
 
-  if (argv.len == 0) {
-    parser_error(peek(), "Expected command.");
+  if (argv.len == 0 && redirects.len == 0) {
+    parser_error(parser, peek(parser), "Expected command.");
   }
 
-  return create_job_command(argv);
+  return create_job_command(parser->arena, argv, redirects);
 }
 
-Job *parse_pipeline()
+Job *parse_pipeline(Parser *parser)
 {
-  Job *job = parse_simple_command();
+  Job *job = parse_simple_command(parser);
 
-  while (check(TOKEN_PIPE)) {
-    Token pipe = advance();
-    Job *right = parse_simple_command();
-    job = create_job_binary(job, clone_token(pipe), right);
+  if (!check(parser, TOKEN_PIPE)) {
+    return job;
   }
 
-  return job;
+  Job_Array stages = {0};
+  arena_da_append(parser->arena, &stages, job);
+
+  while (check(parser, TOKEN_PIPE)) {
+    advance(parser);
+    arena_da_append(parser->arena, &stages, parse_simple_command(parser));
+  }
+
+  return create_job_pipeline(parser->arena, stages);
 }
 
-Job *parse_and()
+Job *parse_and(Parser *parser)
 {
-  Job *job = parse_pipeline();
+  Job *job = parse_pipeline(parser);
 
-  while (check(TOKEN_AND)) {
-    Token and_if = advance();
-    Job *right = parse_pipeline();
-    job = create_job_binary(job, clone_token(and_if), right);
+  while (check(parser, TOKEN_AND)) {
+    Token and_if = advance(parser);
+    Job *right = parse_pipeline(parser);
+    job = create_job_binary(parser->arena, job, and_if, right);
   }
 
   return job;
 }
 
-Job *parse_or()
+Job *parse_or(Parser *parser)
 {
-  Job *job = parse_and();
+  Job *job = parse_and(parser);
 
-  while (check(TOKEN_OR)) {
-    Token or = advance();
-    Job *right = parse_and();
-    job = create_job_binary(job, clone_token(or), right);
+  while (check(parser, TOKEN_OR)) {
+    Token or = advance(parser);
+    Job *right = parse_and(parser);
+    job = create_job_binary(parser->arena, job, or, right);
   }
 
   return job;
 }
 
-Job *parse_background_job()
+Job *parse_background_job(Parser *parser)
 {
-  Job *job = parse_or();
+  Job *job = parse_or(parser);
 
-  if (check(TOKEN_AMPERSAND)) {
-    Token ampersand = advance();
-    return create_job_unary(clone_token(ampersand), job);
+  if (check(parser, TOKEN_AMPERSAND)) {
+    Token ampersand = advance(parser);
+    return create_job_unary(parser->arena, ampersand, job);
   }
 
   return job;
 }
 
-Job *parse_job()
+Job *parse_job(Parser *parser)
 {
-  return parse_background_job();
+  return parse_background_job(parser);
 }
 
-Statement *parse_job_statement()
+Statement *parse_job_statement(Parser *parser)
 {
-  Job *job = parse_job();
-  return job ? create_statement_job(job) : NULL;
+  Job *job = parse_job(parser);
+  return job ? create_statement_job(parser->arena, job) : NULL;
 }
 
-Statement_Array parse_block_until(Token_Type types[], int len)
+Statement_Array parse_block_until(Parser *parser, Token_Type types[], int len)
 {
   Statement_Array statements = {0};
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  while (!is_at_end() && !check_array(types, len)) {
+  while (!is_at_end(parser) && !check_array(parser, types, len)) {
 
-    z_da_append(&statements, parse_statement());
+    arena_da_append(parser->arena, &statements, parse_statement(parser));
 
-    if (parser_state->panic_mode) {
-      synchronize();
+    if (parser->panic_mode) {
+      synchronize(parser);
     }
 
-    skip_empty_statements();
+    skip_empty_statements(parser);
   }
 
   return statements;
 }
 
-Statement_Array parse_block_until_end()
+Statement_Array parse_block_until_end(Parser *parser)
 {
   Token_Type end[] = { TOKEN_END };
-  return parse_block_until(end, Z_ARRAY_LEN(end));
+  return parse_block_until(parser, end, Z_ARRAY_LEN(end));
 }
 
-Statement *parse_if_statement()
+Statement *parse_if_statement(Parser *parser)
 {
   Token_Type if_body_end[] = {TOKEN_ELSE, TOKEN_END};
 
-  Job *condition = parse_job();
+  Job *condition = parse_job(parser);
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  Statement_Array ifBranch = parse_block_until(if_body_end, Z_ARRAY_LEN(if_body_end));
+  Statement_Array ifBranch = parse_block_until(parser, if_body_end, Z_ARRAY_LEN(if_body_end));
   Statement_Array elseBranch = {0};
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  if (match(TOKEN_ELSE)) {
-    elseBranch = parse_block_until_end();
+  if (match(parser, TOKEN_ELSE)) {
+    elseBranch = parse_block_until_end(parser);
   }
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  consume(TOKEN_END, "Expected 'end' after if statement");
+  consume(parser, TOKEN_END, "Expected 'end' after if statement");
 
-  return create_statement_if(condition, ifBranch, elseBranch);
+  return create_statement_if(parser->arena, condition, ifBranch, elseBranch);
 }
 
-Statement *parse_while_statement()
+Statement *parse_while_statement(Parser *parser)
 {
-  Job *condition = parse_job();
+  Job *condition = parse_job(parser);
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  Statement_Array body = parse_block_until_end();
+  Statement_Array body = parse_block_until_end(parser);
 
-  consume(TOKEN_END, "Expected 'end' after while statement");
+  consume(parser, TOKEN_END, "Expected 'end' after while statement");
 
-  return create_statement_while(condition, body);
+  return create_statement_while(parser->arena, condition, body);
 }
 
-Statement *parse_for_statement()
+Statement *parse_for_statement(Parser *parser)
 {
-  Token var_name = consume_string("Expected idenifier after for.");
-  consume(TOKEN_IN, "Expected 'in' after idenifier.");
+  Token var_name = consume_string(parser, "Expected idenifier after for.");
+  bool from_command = match(parser, TOKEN_FROM);
+
+  if (!from_command) {
+    consume(parser, TOKEN_IN, "Expected 'in' or 'from' after idenifier.");
+  }
+
+  Token string = consume_string(parser, from_command ? "Expected command after from." : "Expected string after in.");
 
-  Token string = consume_string("Expected string after in.");
-  consume(TOKEN_BY, "Expected 'by' after idenifier.");
+  // without 'by' a command's output is split into lines, and a string
+  // like words are
+  Z_String_View default_delim = from_command ? Z_CSTR("\n") : Z_CSTR(" \n");
+  Token delim = { .type = TOKEN_DQUOTED_STRING, .lexeme = default_delim, .line = string.line, .column = string.column };
+
+  if (match(parser, TOKEN_BY)) {
+    delim = consume_string(parser, "Expected delimeter string after by.");
+  }
 
-  Token delim = consume_string("Expected delimeter string after by.");
+  bool parallel = match(parser, TOKEN_PARALLEL);
+  Token workers = parallel ? consume_string(parser, "Expected number of workers after parallel.") : (Token){0};
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  Statement_Array body = parse_block_until_end();
-  consume(TOKEN_END, "Expected 'end' after if statement");
+  Statement_Array body = parse_block_until_end(parser);
+  consume(parser, TOKEN_END, "Expected 'end' after if statement");
 
-  return create_statement_for(clone_token(var_name), clone_token(string), clone_token(delim), body);
+  return create_statement_for(parser->arena, var_name, string, delim, from_command, parallel, workers, body);
 }
 
-Statement *parse_function_statement()
+Statement *parse_function_statement(Parser *parser)
 {
-  Token name = consume(TOKEN_WORD, "Expected function name after 'fn'");
+  Token name = consume(parser, TOKEN_WORD, "Expected function name after 'fn'");
 
-  skip_empty_statements();
+  skip_empty_statements(parser);
 
-  Statement_Array body = parse_block_until_end();
+  Statement_Array body = parse_block_until_end(parser);
 
-  consume(TOKEN_END, "Expected 'end' after function body.");
+  consume(parser, TOKEN_END, "Expected 'end' after function body.");
 
-  return create_statement_function(clone_token(name), body);
+  return create_statement_function(parser->arena, name, body);
 }
 
-Statement *parse_statement()
+Statement *parse_statement(Parser *parser)
 {
-  if (match(TOKEN_IF))    return parse_if_statement();
-  if (match(TOKEN_FOR))   return parse_for_statement();
-  if (match(TOKEN_WHILE)) return parse_while_statement();
-  if (match(TOKEN_FUN))   return parse_function_statement();
-  return parse_job_statement();
+  if (match(parser, TOKEN_IF))    return parse_if_statement(parser);
+  if (match(parser, TOKEN_FOR))   return parse_for_statement(parser);
+  if (match(parser, TOKEN_WHILE)) return parse_while_statement(parser);
+  if (match(parser, TOKEN_FUN))   return parse_function_statement(parser);
+  return parse_job_statement(parser);
 }
 
-Statement_Array parse(const Token_Array *tokens, const char *source)
+// the AST is allocated in arena, which the caller frees
+Statement_Array parse(const Token_Array *tokens, const char *source, Arena *arena)
 {
-  parser_init(tokens, source);
-  Statement_Array statements = parse_block_until(NULL, 0);
+  Parser parser;
+  parser_init(&parser, tokens, source, arena);
+  Statement_Array statements = parse_block_until(&parser, NULL, 0);
+  bool had_error = parser.had_error;
+  parser_free(&parser);
 
-  if (parser_state->had_error) {
-    free_statements(&statements);
-    parser_free();
-    return (Statement_Array){0};
-  }
-
-  parser_free();
-  return statements;
+  return had_error ? (Statement_Array){0} : statements;
 }
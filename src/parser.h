@@ -1,12 +1,26 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "arena.h"
 #include "lexer.h"
 #include "libzatar.h"
 #include "token.h"
 #include "ast.h"
 #include <stdbool.h>
 
-Statement_Array parse(const Token_Array *t, const char *_source);
+// like the lexer, a parse keeps its state to itself
+typedef struct {
+  const Token_Array *tokens;
+  int curr;
+  bool had_error;
+  bool panic_mode;
+  const char *source;
+  char **source_by_lines;
+  Arena *arena;
+} Parser;
+
+void parser_init(Parser *parser, const Token_Array *tokens, const char *source, Arena *arena);
+void parser_free(Parser *parser);
+Statement_Array parse(const Token_Array *t, const char *_source, Arena *arena);
 
 #endif
@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include "pipe_writer.h"
+#include "cstr.h"
+#include "libzatar.h"
+#include "output.h"
+#include "spawn.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define INITIAL_CAPACITY (64 * 1024)
+
+// below this a plain write is as cheap as mapping the pages into the
+// pipe
+#define VMSPLICE_MIN (64 * 1024)
+
+struct Pipe_Writer {
+  pthread_t thread;
+  bool threaded;
+  int fd;
+  char *buffer;
+  size_t len;
+  size_t capacity;
+  int status;
+  bool broken;
+};
+
+typedef struct {
+  Pipe_Writer **ptr;
+  int len;
+  int cap;
+} Pipe_Writer_Array;
+
+// writers whose thread may still be running. a fork has to close their
+// fds in the child, otherwise the readers never see EOF. the lock keeps
+// a thread from closing its fd while the shell forks.
+static Pipe_Writer_Array writers = {0};
+static pthread_mutex_t writers_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool fork_handlers_installed = false;
+
+static void lock_writers()
+{
+  pthread_mutex_lock(&writers_lock);
+}
+
+static void unlock_writers()
+{
+  pthread_mutex_unlock(&writers_lock);
+}
+
+// the buffer is an anonymous mapping grown with mremap, so growing it
+// never copies and its pages can be handed to the pipe as they are
+static bool buffer_append(Pipe_Writer *writer, const char *data, size_t size)
+{
+  if (writer->len + size > writer->capacity) {
+    size_t capacity = writer->capacity ? writer->capacity : INITIAL_CAPACITY;
+
+    while (capacity < writer->len + size) {
+      capacity *= 2;
+    }
+
+    void *buffer = writer->buffer
+      ? mremap(writer->buffer, writer->capacity, capacity, MREMAP_MAYMOVE)
+      : mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buffer == MAP_FAILED) {
+      return false;
+    }
+
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+  }
+
+  memcpy(writer->buffer + writer->len, data, size);
+  writer->len += size;
+
+  return true;
+}
+
+// everything is copied, even the builtin's own arguments. the pipe
+// only references vmspliced pages, and the arguments' arena is
+// released long before the reader is done with them.
+static ssize_t output_write(void *cookie, const char *data, size_t size)
+{
+  Pipe_Writer *writer = cookie;
+
+  return buffer_append(writer, data, size) ? (ssize_t)size : 0;
+}
+
+static bool write_chunk(Pipe_Writer *writer, const char *data, size_t len)
+{
+  bool use_vmsplice = len >= VMSPLICE_MIN;
+  size_t offset = 0;
+
+  while (offset < len) {
+    struct iovec iov = { .iov_base = (char *)data + offset, .iov_len = len - offset };
+    ssize_t n = use_vmsplice
+      ? vmsplice(writer->fd, &iov, 1, 0)
+      : write(writer->fd, iov.iov_base, iov.iov_len);
+
+    if (n < 0 && errno == EINVAL && use_vmsplice) {
+      // not a pipe, the last stage writes straight to our stdout
+      use_vmsplice = false;
+      continue;
+    }
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      writer->broken = errno == EPIPE;
+      return false;
+    }
+
+    offset += n;
+  }
+
+  return true;
+}
+
+// large outputs are vmspliced, the pipe then references the buffer's
+// pages instead of copying them. unmapping the buffer afterwards is
+// safe, its pages live on until the reader has consumed them.
+static void *write_output(void *arg)
+{
+  Pipe_Writer *writer = arg;
+
+  if (writer->buffer) {
+    write_chunk(writer, writer->buffer, writer->len);
+    munmap(writer->buffer, writer->capacity);
+  }
+
+  lock_writers();
+  close(writer->fd);
+  writer->fd = -1;
+  unlock_writers();
+
+  return NULL;
+}
+
+// runs a builtin right here instead of in a fork. what it prints is
+// collected first and fed to out_fd from a thread, so the shell can go
+// on starting the stages that will read it.
+Pipe_Writer *pipe_writer_start(BuiltinFn builtin, char **argv, int out_fd)
+{
+  if (!fork_handlers_installed) {
+    pthread_atfork(lock_writers, unlock_writers, unlock_writers);
+    fork_handlers_installed = true;
+  }
+
+  Pipe_Writer *writer = calloc(1, sizeof(Pipe_Writer));
+  FILE *stream = fopencookie(writer, "w", (cookie_io_functions_t){ .write = output_write });
+  setvbuf(stream, NULL, _IONBF, 0);
+
+  output_begin_stream(stream);
+  writer->status = builtin(str_array_len(argv), argv);
+  output_end_stream();
+  fclose(stream);
+
+  writer->fd = fcntl(out_fd, F_DUPFD_CLOEXEC, 0);
+  z_da_append(&writers, writer);
+
+  // a reader that went away turns into EPIPE for the thread instead of
+  // a SIGPIPE that would kill the shell. the thread inherits the mask.
+  sigset_t block, old;
+  sigemptyset(&block);
+  sigaddset(&block, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &block, &old);
+  writer->threaded = pthread_create(&writer->thread, NULL, write_output, writer) == 0;
+
+  if (!writer->threaded) {
+    write_output(writer);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  return writer;
+}
+
+// returns a wait status, as if the stage had been a process
+int pipe_writer_wait(Pipe_Writer *writer)
+{
+  if (writer->threaded) {
+    pthread_join(writer->thread, NULL);
+  }
+
+  for (int i = 0; i < writers.len; i++) {
+    if (writers.ptr[i] == writer) {
+      writers.ptr[i] = writers.ptr[--writers.len];
+      break;
+    }
+  }
+
+  int status = writer->broken ? W_EXITCODE(0, SIGPIPE) : W_EXITCODE(child_exit_code(writer->status) & 0xff, 0);
+  free(writer);
+
+  return status;
+}
+
+// a forked child doesn't have the threads, only copies of their fds
+void pipe_writer_reset()
+{
+  z_da_foreach(Pipe_Writer **, writer, &writers) {
+    if ((*writer)->fd >= 0) {
+      close((*writer)->fd);
+    }
+  }
+
+  writers.len = 0;
+}
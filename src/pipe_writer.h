@@ -0,0 +1,12 @@
+#ifndef PIPE_WRITER_H
+#define PIPE_WRITER_H
+
+#include "builtins/builtin.h"
+
+typedef struct Pipe_Writer Pipe_Writer;
+
+Pipe_Writer *pipe_writer_start(BuiltinFn builtin, char **argv, int out_fd);
+int pipe_writer_wait(Pipe_Writer *writer);
+void pipe_writer_reset();
+
+#endif
@@ -8,7 +8,7 @@ void render_job(Job *job, Z_String *output);
 void render_job_binary(Job_Binary *job, Z_String *output)
 {
   z_str_append_format(output, "(");
-  z_str_append_str(output, Z_CSTR(job->operator.lexeme));
+  z_str_append_str(output, job->operator.lexeme);
   z_str_append_format(output, " ");
   render_job(job->left, output);
   z_str_append_format(output, " ");
@@ -19,7 +19,7 @@ void render_job_binary(Job_Binary *job, Z_String *output)
 void render_job_unary(Job_Unary *job, Z_String *output)
 {
   z_str_append_format(output, "(");
-  z_str_append_str(output, Z_CSTR(job->operator.lexeme));
+  z_str_append_str(output, job->operator.lexeme);
   z_str_append_format(output, " ");
   render_job(job->child, output);
   z_str_append_format(output, ")");
@@ -29,11 +29,34 @@ void render_job_command(Job_Command *job, Z_String *output)
 {
   z_str_append_format(output, "(");
 
-  z_str_append_str(output, Z_CSTR(job->argv.ptr[0].lexeme));
-
-  for (int i = 1; i < job->argv.len; i++) {
+  for (int i = 0; i < job->argv.len; i++) {
     Token token = job->argv.ptr[i];
-    z_str_append_format(output, " \"%s\"", token.lexeme);
+    z_str_append_format(output, i ? " \"%.*s\"" : "%.*s", token.lexeme.len, token.lexeme.ptr);
+  }
+
+  z_da_foreach(Redirect *, redirect, &job->redirects) {
+    switch (redirect->type) {
+      case REDIRECT_INPUT: z_str_append_format(output, " %d<", redirect->fd); break;
+      case REDIRECT_OUTPUT: z_str_append_format(output, " %d>", redirect->fd); break;
+      case REDIRECT_APPEND: z_str_append_format(output, " %d>>", redirect->fd); break;
+      case REDIRECT_DUPLICATE: z_str_append_format(output, " %d>&%d", redirect->fd, redirect->target_fd); break;
+    }
+
+    if (redirect->type != REDIRECT_DUPLICATE) {
+      z_str_append_format(output, "\"%.*s\"", redirect->target.lexeme.len, redirect->target.lexeme.ptr);
+    }
+  }
+
+  z_str_append_format(output, ")");
+}
+
+void render_job_pipeline(Job_Pipeline *job, Z_String *output)
+{
+  z_str_append_format(output, "(|");
+
+  z_da_foreach(Job **, stage, &job->stages) {
+    z_str_append_format(output, " ");
+    render_job(*stage, output);
   }
 
   z_str_append_format(output, ")");
@@ -49,6 +72,8 @@ void render_job(Job *job, Z_String *output)
     render_job_unary((Job_Unary *)job, output);
   } else if (job->type == JOB_COMMAND) {
     render_job_command((Job_Command *)job, output);
+  } else if (job->type == JOB_PIPELINE) {
+    render_job_pipeline((Job_Pipeline *)job, output);
   } else {
     z_str_append_format(output, "(Unknown)");
   }
@@ -89,17 +114,25 @@ void print_statement_while(Statement_While *statement)
 
 void print_statement_for(Statement_For *statement)
 {
-  printf("for (\"");
-  z_sv_print(Z_CSTR(statement->string.lexeme));
+  printf(statement->from_command ? "for from (\"" : "for (\"");
+  z_sv_print(statement->string.lexeme);
   printf("\" \"");
-  z_sv_print(Z_CSTR(statement->delim.lexeme));
-  printf("\")\n");
+  z_sv_print(statement->delim.lexeme);
+  printf("\"");
+
+  if (statement->parallel) {
+    printf(" parallel \"");
+    z_sv_print(statement->workers.lexeme);
+    printf("\"");
+  }
+
+  printf(")\n");
   print_statements(statement->body);
 }
 
 void print_statement_function(Statement_Function *statement)
 {
-  z_sv_print(Z_CSTR(statement->name.lexeme));
+  z_sv_print(statement->name.lexeme);
   printf("() {\n");
   print_statements(statement->body);
   printf("}\n");
@@ -0,0 +1,31 @@
+#include "program.h"
+#include <stdlib.h>
+
+Program *program_create()
+{
+  Program *program = calloc(1, sizeof(Program));
+  program->refs = 1;
+
+  return program;
+}
+
+Program *program_retain(Program *program)
+{
+  program->refs++;
+
+  return program;
+}
+
+void program_release(Program *program)
+{
+  if (--program->refs > 0) {
+    return;
+  }
+
+  if (program->source) {
+    source_release(program->source);
+  }
+
+  arena_free(&program->arena);
+  free(program);
+}
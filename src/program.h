@@ -0,0 +1,20 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "arena.h"
+#include "source.h"
+
+// a parsed program: the arena its AST was allocated in and the source
+// its tokens point into. functions the program defines share its AST
+// instead of copying their bodies out, so they keep it alive.
+typedef struct {
+  int refs;
+  Arena arena;
+  Source *source;
+} Program;
+
+Program *program_create();
+Program *program_retain(Program *program);
+void program_release(Program *program);
+
+#endif
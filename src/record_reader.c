@@ -0,0 +1,149 @@
+#include "record_reader.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define INITIAL_CAPACITY (64 * 1024)
+
+// records are cut out of one buffer that is refilled with large reads.
+// start is where the next record begins and scanned how far the bytes
+// after it are known to hold no delimiter. the buffer only grows for a
+// record that doesn't fit, so memory stays bounded by the longest one.
+// offset is where in the file the buffered bytes end, for a reader
+// that leaves the fd's own offset alone. it's -1 for a pipe.
+struct Record_Reader {
+  int fd;
+  off_t offset;
+  bool is_delimiter[256];
+  int delimiters_count;
+  char delimiter;
+  char *buffer;
+  int cap;
+  int start;
+  int scanned;
+  int end;
+  bool eof;
+};
+
+// with an offset the reader uses pread from there on, otherwise read
+Record_Reader *record_reader_create(int fd, Z_String_View delimiters, off_t offset)
+{
+  Record_Reader *reader = calloc(1, sizeof(Record_Reader));
+  reader->fd = fd;
+  reader->offset = offset;
+  reader->cap = INITIAL_CAPACITY;
+  reader->buffer = malloc(reader->cap);
+  record_reader_set_delimiters(reader, delimiters);
+
+  return reader;
+}
+
+// delimiters may be any bytes, NUL included
+void record_reader_set_delimiters(Record_Reader *reader, Z_String_View delimiters)
+{
+  memset(reader->is_delimiter, 0, sizeof(reader->is_delimiter));
+  reader->delimiters_count = delimiters.len;
+  reader->delimiter = delimiters.len > 0 ? delimiters.ptr[0] : '\0';
+  reader->scanned = reader->start;
+
+  for (int i = 0; i < delimiters.len; i++) {
+    reader->is_delimiter[(unsigned char)delimiters.ptr[i]] = true;
+  }
+}
+
+// a single delimiter, like a newline or NUL, is found with memchr
+static char *find_delimiter(const Record_Reader *reader, char *p, char *end)
+{
+  if (reader->delimiters_count == 1) {
+    return memchr(p, reader->delimiter, end - p);
+  }
+
+  for (; p < end; p++) {
+    if (reader->is_delimiter[(unsigned char)*p]) {
+      return p;
+    }
+  }
+
+  return NULL;
+}
+
+// moves the partial record to the front, or grows the buffer if it
+// already fills all of it, then reads as much as fits. a byte is kept
+// free to terminate the last record.
+static void fill(Record_Reader *reader)
+{
+  if (reader->start > 0) {
+    memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->scanned -= reader->start;
+    reader->start = 0;
+  }
+
+  if (reader->end + 1 >= reader->cap) {
+    reader->cap *= 2;
+    reader->buffer = realloc(reader->buffer, reader->cap);
+  }
+
+  char *p = reader->buffer + reader->end;
+  size_t size = reader->cap - reader->end - 1;
+  ssize_t n;
+
+  do {
+    n = reader->offset >= 0 ? pread(reader->fd, p, size, reader->offset) : read(reader->fd, p, size);
+  } while (n < 0 && errno == EINTR);
+
+  if (n > 0) {
+    reader->end += n;
+    reader->offset += reader->offset >= 0 ? n : 0;
+  } else {
+    reader->eof = true;
+  }
+}
+
+// the record is a view into the buffer without its delimiter, which is
+// replaced by a NUL. it's valid until the next call. what follows the
+// last delimiter is a record too.
+bool record_reader_next(Record_Reader *reader, Z_String_View *record)
+{
+  for (;;) {
+    char *start = reader->buffer + reader->start;
+    char *delimiter = find_delimiter(reader, reader->buffer + reader->scanned, reader->buffer + reader->end);
+
+    if (delimiter) {
+      *delimiter = '\0';
+      *record = Z_SV(start, delimiter - start);
+      reader->start = reader->scanned = delimiter + 1 - reader->buffer;
+      return true;
+    }
+
+    reader->scanned = reader->end;
+
+    if (reader->eof) {
+      reader->buffer[reader->end] = '\0';
+      *record = Z_SV(start, reader->end - reader->start);
+      reader->start = reader->end;
+      return record->len > 0;
+    }
+
+    fill(reader);
+  }
+}
+
+// where in the file the next record starts, for a reader with an offset
+off_t record_reader_position(const Record_Reader *reader)
+{
+  return reader->offset - (reader->end - reader->start);
+}
+
+int record_reader_fd(const Record_Reader *reader)
+{
+  return reader->fd;
+}
+
+// the fd stays open, it belongs to the caller
+void record_reader_free(Record_Reader *reader)
+{
+  free(reader->buffer);
+  free(reader);
+}
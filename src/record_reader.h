@@ -0,0 +1,16 @@
+#ifndef RECORD_READER_H
+#define RECORD_READER_H
+
+#include "libzatar.h"
+#include <sys/types.h>
+
+typedef struct Record_Reader Record_Reader;
+
+Record_Reader *record_reader_create(int fd, Z_String_View delimiters, off_t offset);
+void record_reader_set_delimiters(Record_Reader *reader, Z_String_View delimiters);
+bool record_reader_next(Record_Reader *reader, Z_String_View *record);
+off_t record_reader_position(const Record_Reader *reader);
+int record_reader_fd(const Record_Reader *reader);
+void record_reader_free(Record_Reader *reader);
+
+#endif
@@ -0,0 +1,381 @@
+#define _GNU_SOURCE
+#include "redirect.h"
+#include "command_hash.h"
+#include "expantion.h"
+#include "libzatar.h"
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// files are moved above the fds a script is likely to redirect, so
+// '3> file' can't end up opening the file as fd 3 and closing it again
+#define FIRST_OPENED_FD 10
+
+#define COPY_CHUNK (1 << 30)
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+static bool is_target(const int *targets, int count, int fd)
+{
+  for (int i = 0; i < count; i++) {
+    if (targets[i] == fd) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// a copy of fd from FIRST_OPENED_FD up that none of the targets is
+// redirected to, otherwise applying 'cmd 11> a 10> b' would overwrite
+// one file's fd with the other
+static int dup_high(int fd, const int *targets, int count)
+{
+  int low = FIRST_OPENED_FD;
+  int high;
+
+  while ((high = fcntl(fd, F_DUPFD_CLOEXEC, low)) >= 0 && is_target(targets, count, high)) {
+    close(high);
+    low = high + 1;
+  }
+
+  return high;
+}
+
+static int open_target(Redirect_Type type, const char *path, const int *targets, int count)
+{
+  int flags = 0;
+
+  switch (type) {
+    case REDIRECT_INPUT: flags = O_RDONLY; break;
+    case REDIRECT_OUTPUT: flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+    case REDIRECT_APPEND: flags = O_WRONLY | O_CREAT | O_APPEND; break;
+    case REDIRECT_DUPLICATE: return -1;
+  }
+
+  int fd = open(path, flags | O_CLOEXEC, 0666);
+
+  if (fd >= 0 && (fd < FIRST_OPENED_FD || is_target(targets, count, fd))) {
+    int high = dup_high(fd, targets, count);
+    close(fd);
+    fd = high;
+  }
+
+  return fd;
+}
+
+// expands the targets and opens the files, before anything runs. on
+// failure nothing stays open and the command shouldn't run at all.
+bool redirects_open(const Redirect_Array *redirects, Arena *arena, Fd_Moves *moves)
+{
+  int targets[redirects->len + 1];
+
+  for (int i = 0; i < redirects->len; i++) {
+    targets[i] = redirects->ptr[i].fd;
+  }
+
+  z_da_foreach(Redirect *, redirect, redirects) {
+    if (redirect->type == REDIRECT_DUPLICATE) {
+      Fd_Move move = { .from = redirect->target_fd, .to = redirect->fd };
+      arena_da_append(arena, moves, move);
+      continue;
+    }
+
+    String_Array words = {0};
+    expand_token(redirect->target, arena, &words);
+
+    if (words.len != 1) {
+      Z_String_View target = redirect->target.lexeme;
+      fprintf(stderr, "'%.*s': ambiguous redirect\n", target.len, target.ptr);
+      redirects_close(moves);
+      return false;
+    }
+
+    int fd = open_target(redirect->type, words.ptr[0], targets, redirects->len);
+
+    if (fd < 0) {
+      fprintf(stderr, "'%s': %s\n", words.ptr[0], strerror(errno));
+      redirects_close(moves);
+      return false;
+    }
+
+    Fd_Move move = { .from = fd, .to = redirect->fd, .owned = true };
+    arena_da_append(arena, moves, move);
+  }
+
+  return true;
+}
+
+void redirects_close(Fd_Moves *moves)
+{
+  z_da_foreach(Fd_Move *, move, moves) {
+    if (move->owned) {
+      close(move->from);
+    }
+  }
+
+  moves->len = 0;
+}
+
+// the fd of the shell that ends up as fd once all moves are applied
+int redirects_resolve(const Fd_Moves *moves, int fd)
+{
+  for (int i = moves->len - 1; i >= 0; i--) {
+    if (moves->ptr[i].to == fd) {
+      fd = moves->ptr[i].from;
+    }
+  }
+
+  return fd;
+}
+
+static bool is_saved(const Saved_Fds *saved, int fd)
+{
+  z_da_foreach(Saved_Fd *, s, saved) {
+    if (s->fd == fd) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// a move that reads fd 1 before it's redirected, like '2>&1'
+static bool reads_stdout(const Fd_Moves *moves)
+{
+  z_da_foreach(Fd_Move *, move, moves) {
+    if (move->from == STDOUT_FILENO) {
+      return true;
+    }
+
+    if (move->to == STDOUT_FILENO) {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+static void save_fd(Saved_Fds *saved, int fd, const int *targets, int count)
+{
+  if (!is_saved(saved, fd)) {
+    Saved_Fd s = { .fd = fd, .saved = dup_high(fd, targets, count) };
+    z_da_append(saved, s);
+  }
+}
+
+// what was written to the capture file goes to the capture around it
+static void copy_capture_file(int fd)
+{
+  char *buffer = malloc(COPY_BUFFER_SIZE);
+  FILE *stream = output_stream();
+  off_t offset = 0;
+  ssize_t n;
+
+  while ((n = pread(fd, buffer, COPY_BUFFER_SIZE, offset)) != 0) {
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      break;
+    }
+
+    fwrite(buffer, 1, n, stream);
+    offset += n;
+  }
+
+  free(buffer);
+  close(fd);
+}
+
+// builtins and functions get their redirections applied to the shell
+// itself, the fds they replace are kept aside until redirects_leave.
+// captured output doesn't go through fd 1, so there a redirected
+// stdout also becomes the stream builtins write to, and a move that
+// reads fd 1 gets a file that is copied into the capture on leave.
+// fails, with nothing left applied, when a fd to duplicate isn't open.
+bool redirects_enter(const Fd_Moves *moves, Saved_Fds *saved)
+{
+  *saved = (Saved_Fds){ .capture_fd = -1 };
+  bool captured = output_is_captured();
+  fflush(output_stream());
+  fflush(stdout);
+
+  int targets[moves->len + 1];
+
+  for (int i = 0; i < moves->len; i++) {
+    targets[i] = moves->ptr[i].to;
+  }
+
+  if (captured && reads_stdout(moves)) {
+    saved->capture_fd = memfd_create("flint-capture", MFD_CLOEXEC);
+    save_fd(saved, STDOUT_FILENO, targets, moves->len);
+    dup2(saved->capture_fd, STDOUT_FILENO);
+  }
+
+  z_da_foreach(Fd_Move *, move, moves) {
+    save_fd(saved, move->to, targets, moves->len);
+
+    if (dup2(move->from, move->to) < 0) {
+      fprintf(stderr, "'%d': %s\n", move->from, strerror(errno));
+      redirects_leave(saved);
+      return false;
+    }
+  }
+
+  if (captured && is_saved(saved, STDOUT_FILENO)) {
+    saved->sink = fdopen(fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, FIRST_OPENED_FD), "w");
+    output_begin_stream(saved->sink);
+  }
+
+  return true;
+}
+
+void redirects_leave(Saved_Fds *saved)
+{
+  if (saved->sink) {
+    output_end_stream();
+    fclose(saved->sink);
+  }
+
+  fflush(stdout);
+
+  for (int i = saved->len - 1; i >= 0; i--) {
+    Saved_Fd s = saved->ptr[i];
+
+    if (s.saved >= 0) {
+      dup2(s.saved, s.fd);
+      close(s.saved);
+    } else {
+      close(s.fd);
+    }
+  }
+
+  if (saved->capture_fd >= 0) {
+    copy_capture_file(saved->capture_fd);
+  }
+
+  z_da_free(saved);
+}
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      return false;
+    }
+
+    data += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+// between regular files copy_file_range lets the kernel (or the file
+// system, with reflinks) do the copy. sendfile takes any output. both
+// only work from a file with a size, pipes and /proc get read / write.
+static bool copy_fd(int in, int out)
+{
+  struct stat st;
+  ssize_t n;
+
+  if (fstat(in, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) > 0 || (n < 0 && errno == EINTR)) { }
+
+    if (n == 0) {
+      return true;
+    }
+
+    while ((n = sendfile(out, in, NULL, COPY_CHUNK)) > 0 || (n < 0 && errno == EINTR)) { }
+
+    if (n == 0) {
+      return true;
+    }
+  }
+
+  char *buffer = malloc(COPY_BUFFER_SIZE);
+  bool ok = true;
+
+  while ((n = read(in, buffer, COPY_BUFFER_SIZE)) != 0) {
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0 || !write_all(out, buffer, n)) {
+      ok = false;
+      break;
+    }
+  }
+
+  free(buffer);
+
+  return ok;
+}
+
+// only the system's cat is stood in for, one of the user's own that
+// comes first in PATH runs as it is
+static bool is_system_cat(const char *name)
+{
+  if (strcmp(name, "cat")) {
+    return false;
+  }
+
+  const char *path = hash_lookup_command(name);
+
+  return path && (!strcmp(path, "/bin/cat") || !strcmp(path, "/usr/bin/cat"));
+}
+
+// 'cat files > out' and 'cat < in > out' are copied in the shell
+// instead of starting cat. anything with an option goes to the real
+// cat, and so does a cat writing to the shell's own stdout.
+bool redirects_cat(char **argv, const Fd_Moves *moves, int *status)
+{
+  int out = redirects_resolve(moves, STDOUT_FILENO);
+  int err = redirects_resolve(moves, STDERR_FILENO);
+
+  if (out == STDOUT_FILENO || !is_system_cat(argv[0])) {
+    return false;
+  }
+
+  for (int i = 1; argv[i]; i++) {
+    if (argv[i][0] == '-') {
+      return false;
+    }
+  }
+
+  *status = 0;
+
+  if (!argv[1] && !copy_fd(redirects_resolve(moves, STDIN_FILENO), out)) {
+    dprintf(err, "cat: %s\n", strerror(errno));
+    *status = W_EXITCODE(1, 0);
+  }
+
+  for (int i = 1; argv[i]; i++) {
+    int in = open(argv[i], O_RDONLY | O_CLOEXEC);
+
+    if (in < 0 || !copy_fd(in, out)) {
+      dprintf(err, "cat: %s: %s\n", argv[i], strerror(errno));
+      *status = W_EXITCODE(1, 0);
+    }
+
+    if (in >= 0) {
+      close(in);
+    }
+  }
+
+  return true;
+}
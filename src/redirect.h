@@ -0,0 +1,42 @@
+#ifndef REDIRECT_H
+#define REDIRECT_H
+
+#include "arena.h"
+#include "ast.h"
+#include <stdio.h>
+
+// a redirection resolved to fds, applied as dup2(from, to). owned
+// moves come from a file opened for the command and close with it.
+typedef struct {
+  int from;
+  int to;
+  bool owned;
+} Fd_Move;
+
+typedef struct {
+  Fd_Move *ptr;
+  int len;
+  int cap;
+} Fd_Moves;
+
+typedef struct {
+  int fd;
+  int saved;
+} Saved_Fd;
+
+typedef struct {
+  Saved_Fd *ptr;
+  int len;
+  int cap;
+  FILE *sink;
+  int capture_fd;
+} Saved_Fds;
+
+bool redirects_open(const Redirect_Array *redirects, Arena *arena, Fd_Moves *moves);
+void redirects_close(Fd_Moves *moves);
+int redirects_resolve(const Fd_Moves *moves, int fd);
+bool redirects_enter(const Fd_Moves *moves, Saved_Fds *saved);
+void redirects_leave(Saved_Fds *saved);
+bool redirects_cat(char **argv, const Fd_Moves *moves, int *status);
+
+#endif
@@ -0,0 +1,53 @@
+#include "source.h"
+#include "libzatar.h"
+#include <stdlib.h>
+#include <string.h>
+
+Source *source_create(Z_String_View text)
+{
+  Source *source = malloc(sizeof(Source) + text.len + 1);
+  source->refs = 1;
+  source->dependencies = (Source_Array){0};
+  source->len = text.len;
+  memcpy(source->text, text.ptr, text.len);
+  source->text[text.len] = '\0';
+
+  return source;
+}
+
+Source *source_retain(Source *source)
+{
+  source->refs++;
+
+  return source;
+}
+
+void source_release(Source *source)
+{
+  if (--source->refs > 0) {
+    return;
+  }
+
+  z_da_foreach(Source **, dependency, &source->dependencies) {
+    source_release(*dependency);
+  }
+
+  z_da_free(&source->dependencies);
+  free(source);
+}
+
+void source_depend(Source *source, Source *dependency)
+{
+  z_da_foreach(Source **, existing, &source->dependencies) {
+    if (*existing == dependency) {
+      return;
+    }
+  }
+
+  z_da_append(&source->dependencies, source_retain(dependency));
+}
+
+Z_String_View source_view(const Source *source)
+{
+  return (Z_String_View){ .ptr = source->text, .len = source->len };
+}
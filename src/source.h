@@ -0,0 +1,31 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include "libzatar.h"
+
+typedef struct Source Source;
+
+typedef struct {
+  Source **ptr;
+  int len;
+  int cap;
+} Source_Array;
+
+// the text a program was lexed from. tokens are views into it, so it
+// stays alive for as long as anything built from those tokens does.
+// sources whose text was spliced into this one (alias expansions) are
+// kept alive along with it.
+struct Source {
+  int refs;
+  Source_Array dependencies;
+  size_t len;
+  char text[];
+};
+
+Source *source_create(Z_String_View text);
+Source *source_retain(Source *source);
+void source_release(Source *source);
+void source_depend(Source *source, Source *dependency);
+Z_String_View source_view(const Source *source);
+
+#endif
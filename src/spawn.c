@@ -0,0 +1,150 @@
+#include "spawn.h"
+#include "command_hash.h"
+#include "cstr.h"
+#include "libzatar.h"
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// both ends are close-on-exec, spawned children only get the end that
+// was explicitly dup2'ed onto their stdin / stdout
+void open_pipe(int fd[2])
+{
+  pipe(fd);
+  fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+}
+
+// a file that isn't a binary and has no '#!' line fails with ENOEXEC,
+// execvp ran those with /bin/sh and so do we
+static int spawn_path(int *pid, const char *path, char **argv, const posix_spawn_file_actions_t *actions)
+{
+  int error = posix_spawn(pid, path, actions, NULL, argv, environ);
+
+  if (error != ENOEXEC) {
+    return error;
+  }
+
+  int argc = str_array_len(argv);
+  char **sh_argv = malloc((argc + 2) * sizeof(char *));
+  sh_argv[0] = "/bin/sh";
+  sh_argv[1] = (char *)path;
+  memcpy(sh_argv + 2, argv + 1, argc * sizeof(char *));
+
+  error = posix_spawn(pid, "/bin/sh", actions, NULL, sh_argv, environ);
+  free(sh_argv);
+
+  return error;
+}
+
+// names without a slash are resolved through the command hash, so $PATH
+// is only walked the first time a command is seen. a cached location
+// that has since disappeared is dropped and resolved again.
+static int spawn_command(int *pid, char **argv, const posix_spawn_file_actions_t *actions)
+{
+  const char *name = argv[0];
+
+  if (strchr(name, '/')) {
+    return spawn_path(pid, name, argv, actions);
+  }
+
+  const char *path = hash_lookup_command(name);
+
+  if (!path) {
+    return ENOENT;
+  }
+
+  int error = spawn_path(pid, path, argv, actions);
+
+  if (error == ENOENT) {
+    hash_forget_command(name);
+    path = hash_lookup_command(name);
+    error = path ? spawn_path(pid, path, argv, actions) : ENOENT;
+  }
+
+  return error;
+}
+
+// posix_spawn is implemented with CLONE_VM | CLONE_VFORK on glibc,
+// so launching a command never copies the interpreter's page tables.
+// redirections are applied in the child after the pipe ends, in the
+// order they were written.
+int spawn_process(char **argv, int in_fd, int out_fd, const Fd_Moves *moves)
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+
+  if (in_fd != STDIN_FILENO) {
+    posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+  }
+
+  if (out_fd != STDOUT_FILENO) {
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+  }
+
+  if (moves) {
+    z_da_foreach(Fd_Move *, move, moves) {
+      posix_spawn_file_actions_adddup2(&actions, move->from, move->to);
+    }
+  }
+
+  // anything still sitting in our stdio buffer has to reach the
+  // terminal before the child starts writing to it
+  fflush(stdout);
+
+  int pid;
+  int error = spawn_command(&pid, argv, &actions);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (error) {
+    fprintf(stderr, "'%s': %s\n", argv[0], strerror(error));
+    return -1;
+  }
+
+  return pid;
+}
+
+int wait_process(int pid)
+{
+  if (pid < 0) {
+    return W_EXITCODE(1, 0);
+  }
+
+  int status = 0;
+
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) { }
+
+  return status;
+}
+
+// the status a script sees for a wait status: the exit code, or 128
+// plus the signal that killed the process
+int exit_code(int status)
+{
+  return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+// builtins return their exit code and commands a wait status, a forked
+// copy of the shell exits with whichever it got
+int child_exit_code(int status)
+{
+  return status & 0xff ? status : WEXITSTATUS(status);
+}
+
+int spawn_and_wait(char **argv, const Fd_Moves *moves)
+{
+  int collect_fd;
+  int out_fd = output_child_fd(&collect_fd);
+  int pid = spawn_process(argv, STDIN_FILENO, out_fd, moves);
+  output_collect(collect_fd, out_fd);
+
+  return wait_process(pid);
+}
@@ -0,0 +1,14 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "redirect.h"
+#include <sys/types.h>
+
+void open_pipe(int fd[2]);
+int spawn_process(char **argv, int in_fd, int out_fd, const Fd_Moves *moves);
+int wait_process(int pid);
+int exit_code(int status);
+int child_exit_code(int status);
+int spawn_and_wait(char **argv, const Fd_Moves *moves);
+
+#endif
@@ -1,95 +1,304 @@
 #include "state.h"
 #include "libzatar.h"
 #include "parser.h"
+#include "source.h"
+#include "table.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 static State *state = NULL;
 
-Scope *new_scope()
+// tables that grew past this are freed instead of recycled, so one
+// big scope doesn't pin its memory for the rest of the session
+#define POOLED_TABLE_MAX_CAPACITY 64
+
+static void reserve_slots(Scope *scope, int slots_count)
 {
-  Scope *scope = malloc(sizeof(Scope));
-  scope->variables = z_map_new((Z_Compare_Fn)strcmp);
-  scope->functions = z_map_new((Z_Compare_Fn)strcmp);
+  if (slots_count > scope->slots_capacity) {
+    free(scope->slots);
+    scope->slots = malloc(sizeof(Value *) * slots_count);
+    scope->slots_capacity = slots_count;
+  }
+
+  if (slots_count > 0) {
+    memset(scope->slots, 0, sizeof(Value *) * slots_count);
+  }
+
+  scope->slots_count = slots_count;
+}
+
+Scope *new_scope(int slots_count)
+{
+  Scope *scope = calloc(1, sizeof(Scope));
+  reserve_slots(scope, slots_count);
 
   return scope;
 }
 
+static Value *new_variable(Z_String_View text)
+{
+  Value *variable = calloc(1, sizeof(Value));
+  value_set_text(variable, text);
+
+  return variable;
+}
+
+static void free_variable(Value *variable)
+{
+  value_free(variable);
+  free(variable);
+}
+
 void free_scope(Scope *scope)
 {
-  z_map_free(scope->variables, free, free);
-  z_map_free(scope->functions, free, (Z_Free_Fn)free_function_statement);
+  table_free(&scope->variables, (Z_Free_Fn)free_variable);
+  table_free(&scope->functions, (Z_Free_Fn)function_release);
+  free(scope->slots);
   free(scope);
 }
 
+static void reset_table(Table *table, Z_Free_Fn free_value)
+{
+  if (table->capacity > POOLED_TABLE_MAX_CAPACITY) {
+    table_free(table, free_value);
+  } else {
+    table_clear(table, free_value);
+  }
+}
+
+static void recycle_scope(Scope *scope)
+{
+  if (scope->functions.count > 0) {
+    state->function_generation++;
+  }
+
+  reset_table(&scope->variables, (Z_Free_Fn)free_variable);
+  reset_table(&scope->functions, (Z_Free_Fn)function_release);
+  z_da_append(&state->pool, scope);
+}
+
 void initialize_state()
 {
-  state = malloc(sizeof(State));
-  action_push_scope();
-  state->alias = z_map_new((Z_Compare_Fn)strcmp);
+  state = calloc(1, sizeof(State));
+  action_push_scope(0);
 }
 
-bool action_mutate_variable(const char *name, const char *value)
+static Value *find_variable(const char *name)
 {
+  Z_String_View key = Z_CSTR(name);
+  uint32_t hash = table_hash(key);
+
   z_da_foreach_reversed(Scope **, scope, &state->scopes) {
-    if (z_map_get((*scope)->variables, name)) {
-      z_map_put((*scope)->variables, strdup(name), strdup(value), free, free);
-      return true;
+    Value *variable = table_get_hashed(&(*scope)->variables, key, hash);
+
+    if (variable) {
+      return variable;
     }
   }
 
-  return false;
+  return NULL;
+}
+
+// the variable's text buffer is reused when the new text fits
+bool action_mutate_variable_text(const char *name, Z_String_View text)
+{
+  Value *variable = find_variable(name);
+
+  if (!variable) {
+    return false;
+  }
+
+  value_set_text(variable, text);
+
+  return true;
+}
+
+bool action_mutate_variable(const char *name, const char *value)
+{
+  return action_mutate_variable_text(name, Z_CSTR(value));
+}
+
+// the text is formatted from the number only once it's expanded
+bool action_mutate_number(const char *name, Number number)
+{
+  Value *variable = find_variable(name);
+
+  if (!variable) {
+    return false;
+  }
+
+  value_set_number(variable, number);
+
+  return true;
+}
+
+// the variable becomes a list if it isn't one yet
+bool action_push_item(const char *name, const char *item)
+{
+  Value *variable = find_variable(name);
+
+  if (!variable) {
+    return false;
+  }
+
+  value_list_push(variable, Z_CSTR(item));
+
+  return true;
+}
+
+// variables are updated in place, so slots bound to them stay valid
+static void put_variable(Scope *scope, const char *name, const char *value)
+{
+  Value *variable = table_get(&scope->variables, Z_CSTR(name));
+
+  if (variable) {
+    value_set_text(variable, Z_CSTR(value));
+  } else {
+    table_put(&scope->variables, Z_CSTR(name), new_variable(Z_CSTR(value)), (Z_Free_Fn)free_variable);
+  }
 }
 
 void action_create_variable(const char *name, const char *value)
 {
-  z_map_put(z_da_peek(&state->scopes)->variables, strdup(name), strdup(value), free, free);
+  put_variable(z_da_peek(&state->scopes), name, value);
+}
+
+// for variables the shell itself maintains, like PIPESTATUS
+void action_create_global_variable(const char *name, const char *value)
+{
+  put_variable(state->scopes.ptr[0], name, value);
+}
+
+void action_bind_slot(int slot, const char *name)
+{
+  Scope *scope = z_da_peek(&state->scopes);
+  scope->slots[slot] = table_get(&scope->variables, Z_CSTR(name));
 }
 
-void action_create_fuction(const char *name, const Statement_Function *fn)
+void action_create_fuction(Flint_Function *function)
 {
-  z_map_put(z_da_peek(&state->scopes)->functions, strdup(name), clone_statement_function(fn), free, (Z_Free_Fn)free_function_statement);
+  Z_String_View name = function->definition->name.lexeme;
+  table_put(&z_da_peek(&state->scopes)->functions, name, function_retain(function), (Z_Free_Fn)function_release);
+  state->function_generation++;
 }
 
+// alias values are lexed straight out of their source, which programs
+// using the alias keep alive even if it is redefined meanwhile
 void action_put_alias(const char *key, const char *value)
 {
-  z_map_put(state->alias, strdup(key), strdup(value), free, free);
+  table_put(&state->alias, Z_CSTR(key), source_create(Z_CSTR(value)), (Z_Free_Fn)source_release);
+}
+
+Value *select_variable_value(const char *name)
+{
+  state->lookups.dynamic++;
+
+  return find_variable(name);
 }
 
 const char *select_variable(const char *name)
 {
-  z_da_foreach_reversed(Scope **, scope, &state->scopes) {
-    if (z_map_get((*scope)->variables, name)) {
-      return z_map_get((*scope)->variables, name);
-    }
+  Value *variable = select_variable_value(name);
+
+  return variable ? value_text(variable) : "";
+}
+
+// an unset or empty variable is 0, false if it holds something else
+bool select_variable_number(const char *name, Number *number)
+{
+  Value *variable = select_variable_value(name);
+
+  if (!variable || (variable->type == VALUE_STRING && variable->len == 0)) {
+    *number = (Number){ .integer = 0 };
+    return true;
   }
 
-  return "";
+  return value_number(variable, number);
 }
 
-const Statement_Function *select_function(const char *name)
+// a resolved reference goes straight to the scope it was declared in.
+// the slot is still empty if the declaration didn't run (or failed),
+// in which case the usual lookup decides.
+Value *select_resolved_value(int depth, int slot, const char *name)
 {
+  Scope *scope = state->scopes.ptr[state->scopes.len - 1 - depth];
+  Value *variable = scope->slots[slot];
+
+  if (!variable) {
+    return select_variable_value(name);
+  }
+
+  state->lookups.resolved++;
+
+  return variable;
+}
+
+const char *select_resolved_variable(int depth, int slot, const char *name)
+{
+  Value *variable = select_resolved_value(depth, slot, name);
+
+  return variable ? value_text(variable) : "";
+}
+
+const Lookup_Counters *select_lookup_counters()
+{
+  return &state->lookups;
+}
+
+Flint_Function *select_function(const char *name)
+{
+  Z_String_View key = Z_CSTR(name);
+  uint32_t hash = table_hash(key);
+
   z_da_foreach_reversed(Scope **, scope, &state->scopes) {
-    if (z_map_get((*scope)->functions, name)) {
-      return z_map_get((*scope)->functions, name);
+    Flint_Function *function = table_get_hashed(&(*scope)->functions, key, hash);
+
+    if (function) {
+      return function;
     }
   }
 
   return NULL;
 }
 
-const char *select_alias(const char *name)
+uint64_t select_function_generation()
+{
+  return state->function_generation;
+}
+
+Source *select_alias(Z_String_View name)
+{
+  return table_get(&state->alias, name);
+}
+
+// identifies the current set of aliases regardless of the order they
+// were defined in, programs are expanded against a specific set
+uint64_t select_alias_fingerprint()
 {
-  return z_map_get(state->alias, name);
+  uint64_t fingerprint = state->alias.count;
+
+  table_foreach(&state->alias, entry) {
+    uint64_t value_hash = table_hash(source_view(entry->value));
+    fingerprint += ((uint64_t)entry->hash << 32 | value_hash) * 0x9e3779b97f4a7c15ull;
+  }
+
+  return fingerprint;
 }
 
-void action_push_scope()
+void action_push_scope(int slots_count)
 {
-  z_da_append(&state->scopes, new_scope());
+  if (state->pool.len == 0) {
+    z_da_append(&state->scopes, new_scope(slots_count));
+    return;
+  }
+
+  Scope *scope = z_da_pop(&state->pool);
+  reserve_slots(scope, slots_count);
+  z_da_append(&state->scopes, scope);
 }
 
 void action_pop_scope()
 {
-  free_scope(z_da_pop(&state->scopes));
+  recycle_scope(z_da_pop(&state->scopes));
 }
@@ -2,11 +2,23 @@
 #define STATE_H
 
 #include "libzatar.h"
+#include "arithmetic.h"
+#include "compiler.h"
 #include "parser.h"
+#include "source.h"
+#include "table.h"
+#include "value.h"
 
+// variables maps names to Values. slots hold the variables the
+// compiler resolved statically, indexed by the slot it assigned. they
+// are filled in when the declaring statement runs and point into the
+// variables table.
 typedef struct {
-  Z_Map *variables;
-  Z_Map *functions;
+  Table variables;
+  Table functions;
+  Value **slots;
+  int slots_count;
+  int slots_capacity;
 } Scope;
 
 typedef struct {
@@ -15,24 +27,48 @@ typedef struct {
   int cap;
 } Scope_Array;
 
+typedef struct {
+  long resolved;
+  long dynamic;
+} Lookup_Counters;
+
+// popped scopes are kept in pool and handed out again by the next push,
+// so entering a block doesn't allocate once the pool is warm.
+// function_generation changes whenever the functions a command name can
+// resolve to do, a definition or a scope with functions going away.
 typedef struct {
   Scope_Array scopes;
-  Z_Map *alias;
+  Scope_Array pool;
+  Table alias;
+  Lookup_Counters lookups;
+  uint64_t function_generation;
 } State;
 
 void initialize_state();
 
 // actions that change the state
 bool action_mutate_variable(const char *name, const char *value);
+bool action_mutate_variable_text(const char *name, Z_String_View text);
+bool action_mutate_number(const char *name, Number number);
+bool action_push_item(const char *name, const char *item);
 void action_create_variable(const char *name, const char *value);
-void action_create_fuction(const char *name, const Statement_Function *fn);
+void action_create_global_variable(const char *name, const char *value);
+void action_create_fuction(Flint_Function *function);
 void action_put_alias(const char *key, const char *value);
-void action_push_scope();
+void action_bind_slot(int slot, const char *name);
+void action_push_scope(int slots_count);
 void action_pop_scope();
 
 // selectors that don't change the state
 const char *select_variable(const char *name);
-const Statement_Function *select_function(const char *name);
-const char *select_alias(const char *name);
+bool select_variable_number(const char *name, Number *number);
+const char *select_resolved_variable(int depth, int slot, const char *name);
+Value *select_variable_value(const char *name);
+Value *select_resolved_value(int depth, int slot, const char *name);
+const Lookup_Counters *select_lookup_counters();
+Flint_Function *select_function(const char *name);
+uint64_t select_function_generation();
+Source *select_alias(Z_String_View name);
+uint64_t select_alias_fingerprint();
 
 #endif
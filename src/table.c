@@ -0,0 +1,200 @@
+#include "table.h"
+#include "libzatar.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_EMPTY -1
+#define TABLE_TOMBSTONE -2
+#define TABLE_MIN_CAPACITY 8
+#define TABLE_MAX_LOAD 0.75
+
+uint32_t table_hash(Z_String_View key)
+{
+  uint32_t hash = 2166136261u;
+
+  for (int i = 0; i < key.len; i++) {
+    hash ^= (uint8_t)key.ptr[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+bool table_entry_is_live(const Table_Entry *entry)
+{
+  return entry->len >= 0;
+}
+
+const char *table_entry_key(const Table_Entry *entry)
+{
+  return entry->len < TABLE_INLINE_KEY_SIZE ? entry->inline_key : entry->heap_key;
+}
+
+static bool entry_matches(const Table_Entry *entry, Z_String_View key, uint32_t hash)
+{
+  return entry->hash == hash
+      && entry->len == key.len
+      && memcmp(table_entry_key(entry), key.ptr, key.len) == 0;
+}
+
+static void set_entry_key(Table_Entry *entry, Z_String_View key, uint32_t hash)
+{
+  char *dst = key.len < TABLE_INLINE_KEY_SIZE ? entry->inline_key : (entry->heap_key = malloc(key.len + 1));
+  memcpy(dst, key.ptr, key.len);
+  dst[key.len] = '\0';
+  entry->len = key.len;
+  entry->hash = hash;
+}
+
+static void free_entry(Table_Entry *entry, Z_Free_Fn free_value)
+{
+  if (entry->len >= TABLE_INLINE_KEY_SIZE) {
+    free(entry->heap_key);
+  }
+
+  if (free_value) {
+    free_value(entry->value);
+  }
+}
+
+// returns the entry holding key, or the slot it should be inserted
+// into (the first tombstone seen, otherwise the empty slot that ended
+// the probe)
+static Table_Entry *find_entry(Table_Entry *entries, int capacity, Z_String_View key, uint32_t hash)
+{
+  uint32_t mask = capacity - 1;
+  Table_Entry *tombstone = NULL;
+
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    Table_Entry *entry = &entries[i];
+
+    if (entry->len == TABLE_EMPTY) {
+      return tombstone ? tombstone : entry;
+    }
+
+    if (entry->len == TABLE_TOMBSTONE) {
+      if (!tombstone) tombstone = entry;
+    } else if (entry_matches(entry, key, hash)) {
+      return entry;
+    }
+  }
+}
+
+static Table_Entry *allocate_entries(int capacity)
+{
+  Table_Entry *entries = malloc(sizeof(Table_Entry) * capacity);
+
+  for (int i = 0; i < capacity; i++) {
+    entries[i].len = TABLE_EMPTY;
+  }
+
+  return entries;
+}
+
+static void grow(Table *table)
+{
+  int capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY : table->capacity * 2;
+  Table_Entry *entries = allocate_entries(capacity);
+
+  table_foreach(table, entry) {
+    Table_Entry *dst = find_entry(entries, capacity, Z_SV(table_entry_key(entry), entry->len), entry->hash);
+    *dst = *entry;
+  }
+
+  free(table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+  table->used = table->count;
+}
+
+void *table_get_hashed(const Table *table, Z_String_View key, uint32_t hash)
+{
+  if (table->count == 0) {
+    return NULL;
+  }
+
+  Table_Entry *entry = find_entry(table->entries, table->capacity, key, hash);
+
+  return table_entry_is_live(entry) ? entry->value : NULL;
+}
+
+void *table_get(const Table *table, Z_String_View key)
+{
+  return table_get_hashed(table, key, table_hash(key));
+}
+
+void table_put(Table *table, Z_String_View key, void *value, Z_Free_Fn free_value)
+{
+  if (table->used + 1 > table->capacity * TABLE_MAX_LOAD) {
+    grow(table);
+  }
+
+  uint32_t hash = table_hash(key);
+  Table_Entry *entry = find_entry(table->entries, table->capacity, key, hash);
+
+  if (table_entry_is_live(entry)) {
+    if (free_value) {
+      free_value(entry->value);
+    }
+
+    entry->value = value;
+    return;
+  }
+
+  if (entry->len == TABLE_EMPTY) {
+    table->used++;
+  }
+
+  table->count++;
+  set_entry_key(entry, key, hash);
+  entry->value = value;
+}
+
+bool table_remove(Table *table, Z_String_View key, Z_Free_Fn free_value)
+{
+  if (table->count == 0) {
+    return false;
+  }
+
+  Table_Entry *entry = find_entry(table->entries, table->capacity, key, table_hash(key));
+
+  if (!table_entry_is_live(entry)) {
+    return false;
+  }
+
+  free_entry(entry, free_value);
+  entry->len = TABLE_TOMBSTONE;
+  table->count--;
+
+  return true;
+}
+
+// keeps the entries array, a table that was never written to is
+// cleared without touching it
+void table_clear(Table *table, Z_Free_Fn free_value)
+{
+  if (table->used == 0) {
+    return;
+  }
+
+  table_foreach(table, entry) {
+    free_entry(entry, free_value);
+  }
+
+  for (int i = 0; i < table->capacity; i++) {
+    table->entries[i].len = TABLE_EMPTY;
+  }
+
+  table->count = 0;
+  table->used = 0;
+}
+
+void table_free(Table *table, Z_Free_Fn free_value)
+{
+  table_foreach(table, entry) {
+    free_entry(entry, free_value);
+  }
+
+  free(table->entries);
+  *table = (Table){0};
+}
@@ -0,0 +1,45 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "libzatar.h"
+#include <stdint.h>
+
+#define TABLE_INLINE_KEY_SIZE 24
+
+// open addressing string -> pointer map. keys shorter than
+// TABLE_INLINE_KEY_SIZE live inside the entry, longer ones are
+// heap allocated. hashes are stored so probing rarely touches keys.
+typedef struct {
+  uint32_t hash;
+  int32_t len;
+  union {
+    char inline_key[TABLE_INLINE_KEY_SIZE];
+    char *heap_key;
+  };
+  void *value;
+} Table_Entry;
+
+typedef struct {
+  Table_Entry *entries;
+  int count;
+  int used;
+  int capacity;
+} Table;
+
+#define table_foreach(table, entry)                                            \
+  for (Table_Entry *entry = (table)->entries;                                  \
+       entry < (table)->entries + (table)->capacity; entry++)                  \
+    if (table_entry_is_live(entry))
+
+uint32_t table_hash(Z_String_View key);
+bool table_entry_is_live(const Table_Entry *entry);
+const char *table_entry_key(const Table_Entry *entry);
+
+void *table_get(const Table *table, Z_String_View key);
+void *table_get_hashed(const Table *table, Z_String_View key, uint32_t hash);
+void table_put(Table *table, Z_String_View key, void *value, Z_Free_Fn free_value);
+bool table_remove(Table *table, Z_String_View key, Z_Free_Fn free_value);
+void table_clear(Table *table, Z_Free_Fn free_value);
+void table_free(Table *table, Z_Free_Fn free_value);
+
+#endif
@@ -2,49 +2,17 @@
 #include "libzatar.h"
 #include <stdio.h>
 #include <stdlib.h>
-
-Token clone_token(Token token)
-{
-  Token new_token = {
-      .column = token.column,
-      .line = token.line,
-      .type = token.type,
-      .lexeme = strdup(token.lexeme),
-  };
-
-  return new_token;
-}
-
-Token_Array clone_tokens(Token_Array tokens)
-{
-  Token_Array new_tokens = {0};
-
-  z_da_foreach(Token *, token, &tokens) {
-    z_da_append(&new_tokens, clone_token(*token));
-  }
-
-  return new_tokens;
-}
-
-void free_token(Token *token)
-{
-  free(token->lexeme);
-}
-
-void free_tokens(Token_Array *tokens)
-{
-  z_da_foreach(Token *, token, tokens) {
-    free_token(token);
-  }
-
-  z_da_free(tokens);
-}
+#include <string.h>
 
 Token_Type get_keyword_type(Z_String_View lexeme, Token_Type fallback)
 {
-#define X(type, token_lexeme, is_keyword)                       \
-  if (is_keyword && z_sv_equal(lexeme, Z_CSTR(token_lexeme))) { \
-    return type;                                                \
+// the length and first character rule out almost every word before
+// the comparison, both are constants for each keyword
+#define X(type, token_lexeme, is_keyword)                                   \
+  if (is_keyword && lexeme.len == sizeof(token_lexeme) - 1                  \
+      && lexeme.ptr[0] == token_lexeme[0]                                   \
+      && !memcmp(lexeme.ptr, token_lexeme, sizeof(token_lexeme) - 1)) {     \
+    return type;                                                            \
   }
   TOKEN_TYPES
 #undef X
@@ -64,7 +32,7 @@ const char *token_type_to_string(Token_Type type)
 
 void print_token(Token token)
 {
-  printf("Token(%s, \"%s\", line: %d, column: %d)\n",token_type_to_string(token.type), token.lexeme, token.line, token.column);
+  printf("Token(%s, \"%.*s\", line: %d, column: %d)\n",token_type_to_string(token.type), token.lexeme.len, token.lexeme.ptr, token.line, token.column);
 }
 
 void print_tokens(const Token_Array *tokens)
@@ -1,6 +1,7 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "arena.h"
 #include "libzatar.h"
 
 #define TOKEN_TYPES                              \
@@ -9,6 +10,7 @@
   X(TOKEN_IN,             "in",             1)   \
   X(TOKEN_BY,             "by",             1)   \
   X(TOKEN_FOR,            "for",            1)   \
+  X(TOKEN_FROM,           "from",           1)   \
   X(TOKEN_FUN,            "fun",            1)   \
   X(TOKEN_END,            "end",            1)   \
   X(TOKEN_AND,            "and",            0)   \
@@ -17,6 +19,8 @@
   X(TOKEN_WORD,           "word",           0)   \
   X(TOKEN_ELSE,           "else",           1)   \
   X(TOKEN_WHILE,          "while",          1)   \
+  X(TOKEN_PARALLEL,       "parallel",       1)   \
+  X(TOKEN_REDIRECT,       "redirect",       0)   \
   X(TOKEN_ERROR,          "error",          0)   \
   X(TOKEN_AMPERSAND,      "ampersand",      0)   \
   X(TOKEN_STATEMENT_END,  "statement_end",  0)   \
@@ -29,9 +33,10 @@ typedef enum {
 #undef X
 } Token_Type;
 
+// lexeme is a view into the Source the token was lexed from
 typedef struct {
   Token_Type type;
-  char *lexeme;
+  Z_String_View lexeme;
   int line;
   int column;
 } Token;
@@ -42,10 +47,6 @@ typedef struct {
   int cap;
 } Token_Array;
 
-void free_token(Token *token);
-void free_tokens(Token_Array *tokens);
-Token clone_token(Token token);
-Token_Array clone_tokens(Token_Array tokens);
 void print_token(Token token);
 const char *token_type_to_string(Token_Type type);
 Token_Type get_keyword_type(Z_String_View lexeme, Token_Type fallback);
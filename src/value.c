@@ -0,0 +1,170 @@
+#include "value.h"
+#include <stdlib.h>
+#include <string.h>
+
+static char *text_buffer(Value *value)
+{
+  return value->cap > 0 ? value->heap_text : value->inline_text;
+}
+
+// makes room for a text of len bytes, what the buffer held is lost
+static char *reserve_text(Value *value, int len)
+{
+  int capacity = value->cap > 0 ? value->cap : VALUE_INLINE_CAPACITY;
+
+  if (len + 1 <= capacity) {
+    return text_buffer(value);
+  }
+
+  int new_cap = z_max(len + 1, capacity * 2);
+
+  if (value->cap > 0) {
+    free(value->heap_text);
+  }
+
+  value->heap_text = malloc(new_cap);
+  value->cap = new_cap;
+
+  return value->heap_text;
+}
+
+static void store_text(Value *value, Z_String_View text)
+{
+  char *buffer = reserve_text(value, text.len);
+  memcpy(buffer, text.ptr, text.len);
+  buffer[text.len] = '\0';
+  value->len = text.len;
+}
+
+static void clear_list(Value *value)
+{
+  z_da_foreach(Value *, item, &value->list) {
+    value_free(item);
+  }
+
+  z_da_free(&value->list);
+  value->list = (Value_Array){0};
+}
+
+void value_set_text(Value *value, Z_String_View text)
+{
+  clear_list(value);
+  store_text(value, text);
+  value->type = VALUE_STRING;
+  value->text_stale = false;
+  value->number_parsed = false;
+}
+
+void value_set_number(Value *value, Number number)
+{
+  clear_list(value);
+  value->type = number.is_float ? VALUE_FLOAT : VALUE_INTEGER;
+  value->text_stale = true;
+  value->number_parsed = true;
+  value->is_number = true;
+  value->number = number;
+}
+
+// a value that isn't a list yet becomes one, holding its text as the
+// first item unless it's empty
+void value_list_push(Value *value, Z_String_View text)
+{
+  if (value->type != VALUE_LIST) {
+    Value first = {0};
+
+    if (value_text(value)[0] != '\0') {
+      value_set_text(&first, Z_SV(value_text(value), value->len));
+      z_da_append(&value->list, first);
+    }
+
+    value->type = VALUE_LIST;
+  }
+
+  Value item = {0};
+  value_set_text(&item, text);
+  z_da_append(&value->list, item);
+  value->text_stale = true;
+}
+
+// anything but a list is a list of itself, or of nothing if it's empty
+Value *value_items(Value *value, int *count)
+{
+  if (value->type == VALUE_LIST) {
+    *count = value->list.len;
+    return value->list.ptr;
+  }
+
+  *count = value_text(value)[0] != '\0';
+
+  return value;
+}
+
+// a list expands to its items separated by spaces
+static void join_list(Value *value)
+{
+  int len = value->list.len > 0 ? value->list.len - 1 : 0;
+
+  z_da_foreach(Value *, item, &value->list) {
+    value_text(item);
+    len += item->len;
+  }
+
+  char *p = reserve_text(value, len);
+
+  for (int i = 0; i < value->list.len; i++) {
+    Value *item = &value->list.ptr[i];
+
+    if (i > 0) {
+      *p++ = ' ';
+    }
+
+    memcpy(p, text_buffer(item), item->len);
+    p += item->len;
+  }
+
+  *p = '\0';
+  value->len = len;
+}
+
+const char *value_text(Value *value)
+{
+  if (value->text_stale) {
+    if (value->type == VALUE_LIST) {
+      join_list(value);
+    } else {
+      char buffer[NUMBER_BUFFER_SIZE];
+      number_format(value->number, buffer);
+      store_text(value, Z_CSTR(buffer));
+    }
+
+    value->text_stale = false;
+  }
+
+  return text_buffer(value);
+}
+
+// strings are parsed once, false if the value isn't a number
+bool value_number(Value *value, Number *number)
+{
+  if (value->type == VALUE_LIST) {
+    return false;
+  }
+
+  if (!value->number_parsed) {
+    value->is_number = number_parse(text_buffer(value), &value->number);
+    value->number_parsed = true;
+  }
+
+  *number = value->number;
+
+  return value->is_number;
+}
+
+void value_free(Value *value)
+{
+  clear_list(value);
+
+  if (value->cap > 0) {
+    free(value->heap_text);
+  }
+}
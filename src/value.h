@@ -0,0 +1,54 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "arithmetic.h"
+#include "libzatar.h"
+#include <stdbool.h>
+
+typedef enum {
+  VALUE_STRING,
+  VALUE_INTEGER,
+  VALUE_FLOAT,
+  VALUE_LIST,
+} Value_Type;
+
+// texts shorter than this are stored inside the value itself
+#define VALUE_INLINE_CAPACITY 24
+
+typedef struct Value Value;
+
+typedef struct {
+  Value *ptr;
+  int len;
+  int cap;
+} Value_Array;
+
+// every value expands to a text. a string's text is the value, numbers
+// and lists format theirs the first time it's asked for. a string that
+// was used as a number keeps the parsed number until it changes. the
+// text buffer is reused as long as the new text fits, a zeroed value is
+// an empty string.
+struct Value {
+  Value_Type type;
+  bool text_stale;
+  bool number_parsed;
+  bool is_number;
+  int len;
+  int cap;
+  union {
+    char inline_text[VALUE_INLINE_CAPACITY];
+    char *heap_text;
+  };
+  Number number;
+  Value_Array list;
+};
+
+void value_set_text(Value *value, Z_String_View text);
+void value_set_number(Value *value, Number number);
+void value_list_push(Value *value, Z_String_View text);
+Value *value_items(Value *value, int *count);
+const char *value_text(Value *value);
+bool value_number(Value *value, Number *number);
+void value_free(Value *value);
+
+#endif
@@ -0,0 +1,340 @@
+#include "vm.h"
+#include "compiler.h"
+#include "cstr.h"
+#include "eval.h"
+#include "expantion.h"
+#include "interpreter.h"
+#include "libzatar.h"
+#include "record_reader.h"
+#include "redirect.h"
+#include "spawn.h"
+#include "state.h"
+#include "worker_pool.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define USE_COMPUTED_GOTO
+#endif
+
+// a loop over a list walks its items, index being the next one. a
+// loop over a command's output reads records from the producer as it
+// writes them. any other loop splits the expanded string.
+typedef struct {
+  Arena_Mark mark;
+  Value *list;
+  int index;
+  Record_Reader *records;
+  int producer;
+  String_Array string;
+  String_Array delim;
+  Z_String_View items;
+  Z_String_View separators;
+  Z_String_View current;
+  bool started;
+  char *name;
+  int workers;
+} Loop;
+
+typedef struct {
+  Loop *ptr;
+  int len;
+  int cap;
+} Loop_Stack;
+
+static int run_command(Compiled_Command *command)
+{
+  Arena *arena = interpreter_arena();
+  Arena_Mark mark = arena_mark(arena);
+  char **argv = expand_planned_argv(&command->plans, arena);
+  Fd_Moves moves = {0};
+  Command_Target target = {0};
+  Command_Target *cached = command->has_static_name ? &command->target : &target;
+  int status = redirects_open(&command->job->redirects, arena, &moves) ? exec_command_target(argv, &moves, cached) : 1;
+  redirects_close(&moves);
+  arena_release(arena, mark);
+
+  if (command->declared_slot >= 0) {
+    action_bind_slot(command->declared_slot, command->declared_name);
+  }
+
+  return status;
+}
+
+static Z_String_View first_word(const String_Array *words)
+{
+  return words->len > 0 ? Z_CSTR(words->ptr[0]) : Z_EMPTY_SV();
+}
+
+// 0 if the count isn't a positive number, the loop then doesn't run
+static int parse_workers(const Argument_Plan *plan, Arena *arena)
+{
+  String_Array words = {0};
+  expand_planned_argument(plan, arena, &words);
+  Z_String_View count = first_word(&words);
+
+  char *end = NULL;
+  long workers = count.len > 0 ? strtol(count.ptr, &end, 10) : 0;
+
+  if (workers < 1 || workers > INT_MAX || *end != '\0') {
+    fprintf(stderr, "for: '%.*s': invalid number of workers\n", count.len, count.ptr);
+    return 0;
+  }
+
+  return workers;
+}
+
+// the producer runs in a child whose stdout is a pipe to the shell, so
+// it writes while the body runs and can't get ahead by more than what
+// the pipe holds
+static Record_Reader *start_producer(const char *command, Z_String_View delimiters, int *pid)
+{
+  int fd[2];
+  open_pipe(fd);
+  *pid = safe_fork();
+
+  if (*pid == 0) {
+    dup2(fd[1], STDOUT_FILENO);
+    close(fd[1]);
+    close(fd[0]);
+    interpret(command);
+    exit(0);
+  }
+
+  close(fd[1]);
+
+  return record_reader_create(fd[0], delimiters, -1);
+}
+
+static void begin_loop(Loop_Stack *loops, const Compiled_Loop *compiled)
+{
+  Arena *arena = interpreter_arena();
+  Loop loop = {0};
+  loop.mark = arena_mark(arena);
+  loop.list = compiled->from_command ? NULL : planned_list(&compiled->string);
+
+  if (!loop.list) {
+    expand_planned_argument(&compiled->string, arena, &loop.string);
+  }
+
+  expand_planned_argument(&compiled->delim, arena, &loop.delim);
+  loop.items = first_word(&loop.string);
+  loop.separators = first_word(&loop.delim);
+  loop.name = compiled->name;
+
+  if (compiled->from_command) {
+    char *command = arena_strndup(arena, loop.items.ptr, loop.items.len);
+    loop.records = start_producer(command, loop.separators, &loop.producer);
+  }
+
+  if (compiled->parallel) {
+    loop.workers = parse_workers(&compiled->workers, arena);
+  }
+
+  action_push_scope(1);
+  action_create_variable(loop.name, "");
+  action_bind_slot(0, loop.name);
+  z_da_append(loops, loop);
+}
+
+// the list may change while the loop runs, it ends once it runs out
+// of items
+static bool next_list_item(Loop *loop)
+{
+  int count;
+  Value *items = value_items(loop->list, &count);
+
+  if (loop->index >= count) {
+    return false;
+  }
+
+  Value *item = &items[loop->index++];
+  const char *text = value_text(item);
+  action_mutate_variable_text(loop->name, Z_SV(text, item->len));
+
+  return true;
+}
+
+// empty records are skipped, like empty items of a string are
+static bool next_record(Loop *loop)
+{
+  Z_String_View record;
+
+  while (record_reader_next(loop->records, &record)) {
+    if (record.len > 0) {
+      action_mutate_variable_text(loop->name, record);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool next_loop_item(Loop *loop)
+{
+  if (loop->list) {
+    return next_list_item(loop);
+  }
+
+  if (loop->records) {
+    return next_record(loop);
+  }
+
+  loop->current = loop->started
+    ? z_sv_split_cset_next(loop->items, loop->current, loop->separators)
+    : z_sv_split_cset_start(loop->items, loop->separators);
+  loop->started = true;
+
+  if (loop->current.len == 0) {
+    return false;
+  }
+
+  action_mutate_variable_text(loop->name, loop->current);
+
+  return true;
+}
+
+// the shell forks a worker for each item and only returns once all of
+// them are done, with the loop's status. the workers return true, with
+// the loop variable set, to run the body once. what the body changes
+// stays in the worker.
+static bool run_parallel_loop(Loop *loop, int *status)
+{
+  if (loop->workers == 0) {
+    *status = 1;
+    return false;
+  }
+
+  Worker_Pool *pool = worker_pool_create(loop->workers);
+
+  while (next_loop_item(loop)) {
+    if (worker_pool_fork(pool) == 0) {
+      return true;
+    }
+  }
+
+  *status = worker_pool_finish(pool);
+
+  return false;
+}
+
+static void end_loop(Loop_Stack *loops)
+{
+  Loop loop = z_da_pop(loops);
+  arena_release(interpreter_arena(), loop.mark);
+
+  if (loop.records) {
+    close(record_reader_fd(loop.records));
+    record_reader_free(loop.records);
+    wait_process(loop.producer);
+  }
+
+  action_pop_scope();
+}
+
+int run_chunk(const Chunk *chunk)
+{
+  const Instruction *code = chunk->code.ptr;
+  const Instruction *ip = code;
+  Loop_Stack loops = {0};
+  int status = 0;
+
+#define OPERAND (ip[-1].operand)
+
+#ifdef USE_COMPUTED_GOTO
+  static void *dispatch_table[] = {
+#define X(op) &&do_##op,
+    OP_CODES
+#undef X
+  };
+
+#define DISPATCH() goto *dispatch_table[(ip++)->op]
+#define CASE(op) do_##op:
+
+  DISPATCH();
+#else
+#define DISPATCH() continue
+#define CASE(op) case op:
+
+  for (;;) switch ((ip++)->op) {
+#endif
+
+  CASE(OP_COMMAND) {
+    status = run_command(&chunk->commands.ptr[OPERAND]);
+    DISPATCH();
+  }
+
+  CASE(OP_JOB) {
+    status = evaluate_job(chunk->jobs.ptr[OPERAND]);
+    DISPATCH();
+  }
+
+  CASE(OP_JUMP) {
+    ip = code + OPERAND;
+    DISPATCH();
+  }
+
+  CASE(OP_JUMP_IF_FAILED) {
+    if (status != 0) ip = code + OPERAND;
+    DISPATCH();
+  }
+
+  CASE(OP_JUMP_IF_SUCCEEDED) {
+    if (status == 0) ip = code + OPERAND;
+    DISPATCH();
+  }
+
+  CASE(OP_PUSH_SCOPE) {
+    action_push_scope(OPERAND);
+    DISPATCH();
+  }
+
+  CASE(OP_POP_SCOPE) {
+    action_pop_scope();
+    DISPATCH();
+  }
+
+  CASE(OP_FOR_BEGIN) {
+    begin_loop(&loops, &chunk->loops.ptr[OPERAND]);
+    DISPATCH();
+  }
+
+  CASE(OP_FOR_NEXT) {
+    if (!next_loop_item(&z_da_peek(&loops))) ip = code + OPERAND;
+    DISPATCH();
+  }
+
+  CASE(OP_FOR_END) {
+    end_loop(&loops);
+    DISPATCH();
+  }
+
+  CASE(OP_FOR_PARALLEL) {
+    if (!run_parallel_loop(&z_da_peek(&loops), &status)) ip = code + OPERAND;
+    DISPATCH();
+  }
+
+  CASE(OP_WORKER_EXIT) {
+    exit(child_exit_code(status));
+  }
+
+  CASE(OP_FUNCTION) {
+    action_create_fuction(chunk->functions.ptr[OPERAND]);
+    DISPATCH();
+  }
+
+  CASE(OP_RETURN) {
+    z_da_free(&loops);
+    return status;
+  }
+
+#ifndef USE_COMPUTED_GOTO
+  }
+#endif
+
+#undef CASE
+#undef DISPATCH
+#undef OPERAND
+}
@@ -0,0 +1,8 @@
+#ifndef VM_H
+#define VM_H
+
+#include "compiler.h"
+
+int run_chunk(const Chunk *chunk);
+
+#endif
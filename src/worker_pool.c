@@ -0,0 +1,208 @@
+#include "worker_pool.h"
+#include "eval.h"
+#include "libzatar.h"
+#include "output.h"
+#include "spawn.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define READ_SIZE (64 * 1024)
+
+// fd is the read end of the worker's stdout, -1 once it hit end of
+// file. output holds what it wrote until it's its turn to be shown.
+typedef struct {
+  pid_t pid;
+  int fd;
+  int status;
+  Z_String output;
+} Worker;
+
+typedef struct {
+  Worker *ptr;
+  int len;
+  int cap;
+} Worker_Array;
+
+// workers are kept in the order of their items. the first one not yet
+// shown streams its output straight through, the others buffer it.
+struct Worker_Pool {
+  Worker_Array workers;
+  int size;
+  int running;
+  int shown;
+};
+
+Worker_Pool *worker_pool_create(int size)
+{
+  Worker_Pool *pool = calloc(1, sizeof(Worker_Pool));
+  pool->size = size;
+
+  return pool;
+}
+
+static void show_output(Worker *worker)
+{
+  if (worker->output.len > 0) {
+    FILE *stream = output_stream();
+    fwrite(worker->output.ptr, 1, worker->output.len, stream);
+    fflush(stream);
+    worker->output.len = 0;
+  }
+}
+
+static void show_finished(Worker_Pool *pool)
+{
+  while (pool->shown < pool->workers.len) {
+    Worker *worker = &pool->workers.ptr[pool->shown];
+    show_output(worker);
+
+    if (worker->fd >= 0) {
+      break;
+    }
+
+    z_str_free(&worker->output);
+    pool->shown++;
+  }
+}
+
+static void finish_worker(Worker_Pool *pool, Worker *worker)
+{
+  close(worker->fd);
+  worker->fd = -1;
+  pool->running--;
+
+  while (waitpid(worker->pid, &worker->status, 0) < 0 && errno == EINTR) { }
+}
+
+static void read_output(Worker_Pool *pool, Worker *worker)
+{
+  z_da_ensure_capacity(&worker->output, worker->output.len + READ_SIZE);
+  ssize_t n = read(worker->fd, worker->output.ptr + worker->output.len, READ_SIZE);
+
+  if (n > 0) {
+    worker->output.len += n;
+  } else if (n == 0 || errno != EINTR) {
+    finish_worker(pool, worker);
+  }
+}
+
+// waits until at least one running worker wrote something or finished
+static void poll_workers(Worker_Pool *pool)
+{
+  struct pollfd *fds = malloc(pool->running * sizeof(struct pollfd));
+  int *indexes = malloc(pool->running * sizeof(int));
+  int len = 0;
+
+  for (int i = pool->shown; i < pool->workers.len; i++) {
+    if (pool->workers.ptr[i].fd >= 0) {
+      fds[len] = (struct pollfd){ .fd = pool->workers.ptr[i].fd, .events = POLLIN };
+      indexes[len++] = i;
+    }
+  }
+
+  if (poll(fds, len, -1) > 0) {
+    for (int i = 0; i < len; i++) {
+      if (fds[i].revents) {
+        read_output(pool, &pool->workers.ptr[indexes[i]]);
+      }
+    }
+  }
+
+  free(fds);
+  free(indexes);
+  show_finished(pool);
+}
+
+static void wait_for_slot(Worker_Pool *pool)
+{
+  while (pool->running >= pool->size) {
+    poll_workers(pool);
+  }
+}
+
+// returns 0 in the new worker, whose stdout is a pipe to the shell and
+// which has no pool anymore, and its pid in the shell once it's started
+int worker_pool_fork(Worker_Pool *pool)
+{
+  wait_for_slot(pool);
+
+  int fd[2];
+  open_pipe(fd);
+  int pid = safe_fork();
+
+  if (pid == 0) {
+    dup2(fd[1], STDOUT_FILENO);
+    close(fd[1]);
+    close(fd[0]);
+
+    z_da_foreach(Worker *, worker, &pool->workers) {
+      if (worker->fd >= 0) {
+        close(worker->fd);
+      }
+
+      z_str_free(&worker->output);
+    }
+
+    z_da_free(&pool->workers);
+    free(pool);
+
+    return 0;
+  }
+
+  close(fd[1]);
+  Worker worker = { .pid = pid, .fd = fd[0] };
+  z_da_append(&pool->workers, worker);
+  pool->running++;
+
+  return pid;
+}
+
+// runs a command as a worker without a copy of the shell. one that
+// can't be started counts as a finished worker that failed.
+void worker_pool_spawn(Worker_Pool *pool, char **argv)
+{
+  wait_for_slot(pool);
+
+  int fd[2];
+  open_pipe(fd);
+  int pid = spawn_process(argv, STDIN_FILENO, fd[1], NULL);
+  close(fd[1]);
+
+  if (pid < 0) {
+    close(fd[0]);
+    Worker worker = { .pid = pid, .fd = -1, .status = wait_process(pid) };
+    z_da_append(&pool->workers, worker);
+    show_finished(pool);
+    return;
+  }
+
+  Worker worker = { .pid = pid, .fd = fd[0] };
+  z_da_append(&pool->workers, worker);
+  pool->running++;
+}
+
+// waits for the remaining workers and frees the pool. the loop fails
+// with the first failure in item order.
+int worker_pool_finish(Worker_Pool *pool)
+{
+  while (pool->running > 0) {
+    poll_workers(pool);
+  }
+
+  int status = 0;
+
+  z_da_foreach(Worker *, worker, &pool->workers) {
+    if (status == 0) {
+      status = worker->status;
+    }
+  }
+
+  z_da_free(&pool->workers);
+  free(pool);
+
+  return status;
+}
@@ -0,0 +1,11 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+typedef struct Worker_Pool Worker_Pool;
+
+Worker_Pool *worker_pool_create(int size);
+int worker_pool_fork(Worker_Pool *pool);
+void worker_pool_spawn(Worker_Pool *pool, char **argv);
+int worker_pool_finish(Worker_Pool *pool);
+
+#endif
@@ -0,0 +1,27 @@
+#!/bin/sh
+# runs every tests/*.flint with the shell given as the first argument
+# and compares what it prints with the .out file next to it. the shell
+# gets an empty home, so no init file or AST cache of the user's is used.
+
+shell=$(realpath "$1")
+dir=$(dirname "$0")
+home=$(mktemp -d)
+trap 'rm -rf "$home"' EXIT
+
+mkdir -p "$home/.config/flint"
+touch "$home/.config/flint/init.flint"
+
+failed=0
+
+for script in "$dir"/*.flint; do
+  name=$(basename "$script" .flint)
+
+  if HOME="$home" XDG_CACHE_HOME="$home/.cache" "$shell" "$script" 2>&1 | cmp -s - "$dir/$name.out"; then
+    echo "ok    $name"
+  else
+    echo "FAIL  $name"
+    failed=1
+  fi
+done
+
+exit $failed